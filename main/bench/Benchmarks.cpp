@@ -0,0 +1,96 @@
+// Benchmarks for the match, tournament and evolution hot paths.
+// JSON for regression tracking: ipd_bench --benchmark_format=json
+// (or --benchmark_out=results.json --benchmark_out_format=json).
+#include <benchmark/benchmark.h>
+#include "Engine.h"
+
+using namespace std;
+
+namespace {
+
+const vector<string> kBuiltins = { "ALLC", "ALLD", "TFT", "GRIM", "PAVLOV", "RND", "CONTRITE", "PROBER", "SUS_TFT", "ALTERNATE" };
+
+vector<string> Strategies(size_t count) {
+    vector<string> names;
+    for (size_t k = 0; k < count; ++k) names.push_back(kBuiltins[k % kBuiltins.size()]);
+    return names;
+}
+
+// Rounds per second for one strategy pair. Args: pair index, epsilon in 1/1000, fast path.
+void BM_Match(benchmark::State& state) {
+    size_t a = static_cast<size_t>(state.range(0)) / kBuiltins.size();
+    size_t b = static_cast<size_t>(state.range(0)) % kBuiltins.size();
+    double epsilon = state.range(1) / 1000.0;
+    bool fast = state.range(2) != 0;
+    const int rounds = 1000;
+    PayoffMatrix<double> payoffs;
+
+    auto p1 = CreateStrategy(kBuiltins[a]);
+    auto p2 = CreateStrategy(kBuiltins[b]);
+    auto f1 = *CreateBuiltin(kBuiltins[a]);
+    auto f2 = *CreateBuiltin(kBuiltins[b]);
+    Seed_Match_Stream(1);
+    for (auto _ : state) {
+        auto scores = fast ? RunBuiltinMatch(f1, f2, rounds, epsilon, payoffs) : RunMatch(*p1, *p2, rounds, epsilon, payoffs);
+        benchmark::DoNotOptimize(scores);
+    }
+    state.SetLabel(kBuiltins[a] + "-" + kBuiltins[b]);
+    state.counters["rounds_per_second"] = benchmark::Counter(static_cast<double>(rounds), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void MatchArgs(benchmark::internal::Benchmark* bench) {
+    for (int64_t pair = 0; pair < static_cast<int64_t>(kBuiltins.size() * kBuiltins.size()); ++pair) {
+        for (int64_t epsilon : { 0, 10 }) {
+            for (int64_t fast : { 0, 1 }) bench->Args({ pair, epsilon, fast });
+        }
+    }
+}
+BENCHMARK(BM_Match)->Apply(MatchArgs)->ArgNames({ "pair", "eps_milli", "fast" });
+
+// Full round robin. Args: strategy count, epsilon in 1/1000.
+void BM_Tournament(benchmark::State& state) {
+    Config cfg;
+    cfg.strategies = Strategies(static_cast<size_t>(state.range(0)));
+    cfg.epsilon = state.range(1) / 1000.0;
+    cfg.rounds = 50;
+    cfg.repeats = 2;
+    cfg.seed = 1;
+    Engine engine(cfg);
+    for (auto _ : state) {
+        auto results = engine.RunTournament();
+        benchmark::DoNotOptimize(results);
+    }
+    double n = static_cast<double>(cfg.strategies.size());
+    double matches = n * (n + 1) / 2 * cfg.repeats;
+    state.counters["matches_per_second"] = benchmark::Counter(matches, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["rounds_per_second"] = benchmark::Counter(matches * cfg.rounds, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_Tournament)
+    ->ArgsProduct({ { 10, 30, 100, 300, 1000 }, { 0, 10 } })
+    ->ArgNames({ "strategies", "eps_milli" })
+    ->Unit(benchmark::kMillisecond);
+
+// Evolution. Args: population, generations, epsilon in 1/1000.
+void BM_Evolution(benchmark::State& state) {
+    Config cfg;
+    cfg.strategies = kBuiltins;
+    cfg.population = static_cast<int>(state.range(0));
+    cfg.generations = static_cast<int>(state.range(1));
+    cfg.epsilon = state.range(2) / 1000.0;
+    cfg.rounds = 50;
+    cfg.seed = 1;
+    for (auto _ : state) {
+        Engine engine(cfg);
+        auto history = engine.RunEvolution();
+        benchmark::DoNotOptimize(history);
+    }
+    state.counters["generations_per_second"] = benchmark::Counter(static_cast<double>(cfg.generations), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_Evolution)
+    ->ArgsProduct({ { 100, 10000 }, { 10, 100, 1000 }, { 0, 10 } })
+    ->ArgNames({ "population", "generations", "eps_milli" })
+    ->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,173 @@
+#include "Engine.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Instrument.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Adaptive repeats (--target-ci). Every pairing starts with config.repeats
+// matches (at least two). A strategy's score is the mean over its opponents of
+// the pairing means, the same estimate as a fixed-repeat run, and its standard
+// error combines the per-pairing variances:
+//   mean_i = (1/n) sum_j m_ij,   se_i^2 = (1/n^2) sum_j v_ij / r_ij.
+// After each pass, a strategy is resolved when its 95% half-width is within
+// target_ci * rounds, or when its interval is clear of its neighbours' in the
+// ranking. For every unresolved strategy, the pairings that contribute at least
+// an average share of its variance get their repeats doubled (up to max_repeats).
+// The run stops when everything is resolved or nothing can grow. Rep k of a
+// pairing always uses the same match stream, so results depend only on the seed.
+
+namespace {
+
+// Longest run of repeats handed to one task.
+const int kRepChunk = 256;
+
+}
+
+void Engine::PlayReps(size_t i, size_t j, int rep_begin, int rep_end, OutcomeCounts* out) {
+    size_t lanes = rep_end - rep_begin;
+    if (TableKernel(i, j)) {
+        PhaseScope phase(Phase::FsmBatch);
+        PairTimer timer(i, j, config.rounds, lanes);
+        if (config.exact) {
+            fill(out, out + lanes, ExactFsmCounts(*fsm_pool[i], *fsm_pool[j], config.rounds, PairNoise(i, j).p1));
+            return;
+        }
+        vector<uint64_t> seeds(lanes);
+        for (size_t k = 0; k < lanes; ++k) seeds[k] = MatchSeed(config.seed, rep_begin + k, i, j);
+        CountFsmBatch(*fsm_pool[i], *fsm_pool[j], config.rounds, PairNoise(i, j).p1, seeds.data(), lanes, out);
+        return;
+    }
+    auto& players = SlotPlayers();
+    for (size_t k = 0; k < lanes; ++k) {
+        PairTimer timer(i, j, config.rounds);
+        Seed_Match_Stream(MatchSeed(config.seed, rep_begin + k, i, j));
+        out[k] = PlayCounts(players, i, j);
+    }
+}
+
+vector<StrategyResult> Engine::AdaptiveTournament(ResultSink* sink) {
+    const size_t n = strategy_pool.size();
+    vector<pair<size_t, size_t>> pairings;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) {
+            pairings.emplace_back(i, j);
+        }
+    }
+    const size_t P = pairings.size();
+
+    vector<double> scb_cost(n, 0.0);
+    if (config.apply_scb) {
+        for (size_t i = 0; i < n; ++i) scb_cost[i] = GetSCB_Cost(names[i]);
+    }
+
+    const int max_repeats = max(2, config.max_repeats);
+    vector<int> reps(P, 0), wanted(P, min(max_repeats, max(2, config.repeats)));
+    // Scores of the first and second player of each pairing (only first for self-play).
+    vector<RunningStats> first(P), second(P);
+    const double limit = config.target_ci * config.rounds;
+    vector<double> mean(n), half(n);
+    vector<bool> resolved(n);
+
+    struct Job { size_t p; int begin, end; size_t offset; };
+    vector<OutcomeCounts> counts;
+
+    for (;;) {
+        vector<Job> jobs;
+        size_t total = 0;
+        for (size_t p = 0; p < P; ++p) {
+            for (int b = reps[p]; b < wanted[p]; b += kRepChunk) {
+                int e = min(wanted[p], b + kRepChunk);
+                jobs.push_back({ p, b, e, total });
+                total += e - b;
+            }
+        }
+        counts.resize(total);
+        auto run = [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                const auto& job = jobs[k];
+                PlayReps(pairings[job.p].first, pairings[job.p].second, job.begin, job.end, &counts[job.offset]);
+            }
+        };
+        if (pool) pool->ParallelFor(jobs.size(), 1, run);
+        else run(0, jobs.size());
+
+        // Fold in (pairing, rep) order so the statistics never depend on scheduling.
+        PhaseScope phase(Phase::Fold);
+        for (const auto& job : jobs) {
+            size_t i = pairings[job.p].first, j = pairings[job.p].second;
+            for (int r = job.begin; r < job.end; ++r) {
+                auto scores = counts[job.offset + (r - job.begin)].Score(config.payoffs);
+                scores.first -= scb_cost[i];
+                scores.second -= scb_cost[j];
+                if (sink) sink->OnMatch(r, i, j, scores.first, scores.second);
+                first[job.p].Push(scores.first);
+                if (i != j) second[job.p].Push(scores.second);
+            }
+            reps[job.p] = job.end;
+        }
+
+        // (pairing, v / r) terms of each strategy's squared standard error.
+        vector<vector<pair<size_t, double>>> terms(n);
+        vector<double> variance(n, 0.0);
+        fill(mean.begin(), mean.end(), 0.0);
+        for (size_t p = 0; p < P; ++p) {
+            size_t i = pairings[p].first, j = pairings[p].second;
+            double vi = first[p].SampleVariance() / reps[p];
+            mean[i] += first[p].mean / n;
+            variance[i] += vi;
+            terms[i].emplace_back(p, vi);
+            if (i != j) {
+                double vj = second[p].SampleVariance() / reps[p];
+                mean[j] += second[p].mean / n;
+                variance[j] += vj;
+                terms[j].emplace_back(p, vj);
+            }
+        }
+        for (size_t i = 0; i < n; ++i) half[i] = 1.96 * sqrt(variance[i]) / n;
+
+        vector<size_t> order(n);
+        iota(order.begin(), order.end(), size_t(0));
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return mean[a] > mean[b]; });
+        auto apart = [&](size_t above, size_t below) { return mean[above] - half[above] > mean[below] + half[below]; };
+        bool done = true;
+        for (size_t r = 0; r < n; ++r) {
+            size_t i = order[r];
+            bool separated = (r == 0 || apart(order[r - 1], i)) && (r + 1 == n || apart(i, order[r + 1]));
+            resolved[i] = half[i] <= limit || separated;
+            done = done && resolved[i];
+        }
+        if (done) break;
+
+        bool grew = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (resolved[i]) continue;
+            for (const auto& term : terms[i]) {
+                size_t p = term.first;
+                if (term.second > 0.0 && term.second * terms[i].size() >= variance[i] && wanted[p] < max_repeats) {
+                    wanted[p] = max(wanted[p], min(max_repeats, 2 * reps[p]));
+                    grew = true;
+                }
+            }
+        }
+        if (!grew) break;
+    }
+
+    vector<StrategyResult> results;
+    for (size_t i = 0; i < n; ++i) {
+        RunningStats pooled;
+        for (size_t p = 0; p < P; ++p) {
+            if (pairings[p].first == i) pooled.Merge(first[p]);
+            else if (pairings[p].second == i) pooled.Merge(second[p]);
+        }
+        StrategyResult res = StrategyResult::compute(names[i], pooled);
+        res.strategy = i;
+        res.mean_score = mean[i];
+        res.ci_lower = mean[i] - half[i];
+        res.ci_upper = mean[i] + half[i];
+        results.push_back(res);
+    }
+    return results;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Strategy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for strategy instances. Instances cloned in one go sit next to
+// each other, and Reset keeps the blocks, so a worker that clones the same set
+// of strategies again (each pairing's lanes, say) allocates nothing from the heap.
+// Single-threaded: each worker owns its arenas.
+class StrategyArena : public std::pmr::memory_resource {
+private:
+    static constexpr size_t kBlockSize = 16384;
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::vector<size_t> sizes;
+    size_t block = 0, offset = 0;
+    std::vector<Strategy*> owned;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        for (;; ++block, offset = 0) {
+            if (block == blocks.size()) {
+                sizes.push_back(std::max(kBlockSize, bytes + alignment));
+                blocks.emplace_back(new std::byte[sizes.back()]);
+            }
+            auto base = reinterpret_cast<uintptr_t>(blocks[block].get());
+            size_t start = ((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (start + bytes <= sizes[block]) {
+                offset = start + bytes;
+                return blocks[block].get() + start;
+            }
+        }
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    StrategyArena() = default;
+    StrategyArena(const StrategyArena&) = delete;
+    StrategyArena& operator=(const StrategyArena&) = delete;
+    ~StrategyArena() override { Reset(); }
+
+    Strategy* Clone(const Strategy& prototype) {
+        owned.push_back(prototype.clone_into(*this));
+        return owned.back();
+    }
+
+    // Destroys every clone; the memory is reused by the next ones.
+    void Reset() {
+        for (Strategy* s : owned) s->~Strategy();
+        owned.clear();
+        block = 0;
+        offset = 0;
+    }
+};
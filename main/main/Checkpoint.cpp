@@ -0,0 +1,159 @@
+#include "Checkpoint.h"
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+
+namespace {
+
+struct CheckpointHeader {
+    char magic[8];        // "IPDCKP2"; 2 since MatchSeed mixes the seed on its own
+    uint32_t key_size;
+    uint32_t strategies;
+    int32_t generation;
+    uint32_t stopped;
+    uint64_t history;     // valid records in path.history
+    uint32_t rng_size;
+    uint32_t reserved;
+};
+
+string HistoryPath(const string& path) { return path + ".history"; }
+
+}
+
+string EvolutionCheckpointKey(const Config& config) {
+    string key = "strategies=";
+    for (size_t k = 0; k < config.strategies.size(); ++k) key += (k ? "," : "") + config.strategies[k];
+    char tail[320];
+    snprintf(tail, sizeof(tail), ";rounds=%d;epsilon=%.17g;seed=%u;population=%d;mutation=%.17g;payoffs=%.17g,%.17g,%.17g,%.17g;scb=%d;exact=%d;selection=",
+        config.rounds, config.epsilon, config.seed, config.population, config.mutation,
+        config.payoffs.T_temptation, config.payoffs.R_reward, config.payoffs.P_punishment, config.payoffs.S_sucker,
+        config.apply_scb ? 1 : 0, config.exact ? 1 : 0);
+    return key + tail + config.selection + ";noise=" + NoiseKey(config);
+}
+
+bool LoadCheckpoint(const string& path, const string& key, EvolutionState& state, vector<HistoryRecord>& history) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    CheckpointHeader header{};
+    string stored;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "IPDCKP2", 8) == 0;
+    if (ok) {
+        stored.resize(header.key_size);
+        state.population.resize(header.strategies);
+        state.rng.resize(header.rng_size);
+        ok = fread(&stored[0], 1, stored.size(), in) == stored.size()
+            && fread(state.population.data(), sizeof(int), state.population.size(), in) == state.population.size()
+            && fread(&state.rng[0], 1, state.rng.size(), in) == state.rng.size();
+    }
+    fclose(in);
+    if (!ok) throw runtime_error("Damaged checkpoint: " + path);
+    if (stored != key) throw runtime_error("Checkpoint " + path + " was written by a run with different settings");
+    state.generation = header.generation;
+    state.stopped = header.stopped != 0;
+
+    history.resize(header.history);
+    FILE* h = fopen(HistoryPath(path).c_str(), "rb");
+    ok = h && fread(history.data(), sizeof(HistoryRecord), history.size(), h) == history.size();
+    if (h) fclose(h);
+    if (!ok) throw runtime_error("Truncated checkpoint history: " + HistoryPath(path));
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter(const string& path_, const string& key_, uint64_t kept) : path(path_), key(key_), written(kept) {
+    string name = HistoryPath(path);
+    if (kept == 0) {
+        remove(path.c_str()); // an older run's state would not match the emptied history
+        history = fopen(name.c_str(), "wb");
+    }
+    else {
+        filesystem::resize_file(name, kept * sizeof(HistoryRecord));
+        history = fopen(name.c_str(), "ab");
+    }
+    if (!history) throw runtime_error("Cannot write checkpoint: " + name);
+    worker = thread([this] { Run(); });
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        lock_guard<mutex> lk(m);
+        closing = true;
+    }
+    cv.notify_all();
+    worker.join();
+    fclose(history);
+}
+
+void CheckpointWriter::Save(const EvolutionState& state, vector<HistoryRecord> records) {
+    {
+        lock_guard<mutex> lk(m);
+        pending = state;
+        pending_history.insert(pending_history.end(), records.begin(), records.end());
+        queued = true;
+    }
+    cv.notify_all();
+}
+
+void CheckpointWriter::Flush() {
+    unique_lock<mutex> lk(m);
+    cv.wait(lk, [this] { return !queued && !busy; });
+    if (error) rethrow_exception(error);
+}
+
+void CheckpointWriter::Run() {
+    unique_lock<mutex> lk(m);
+    for (;;) {
+        cv.wait(lk, [this] { return queued || closing; });
+        if (!queued) return;
+        EvolutionState state = move(pending);
+        vector<HistoryRecord> records;
+        records.swap(pending_history);
+        queued = false;
+        if (error) {
+            cv.notify_all(); // the history file is out of step with the state: write nothing more
+            continue;
+        }
+        busy = true;
+        lk.unlock();
+        exception_ptr failed;
+        try {
+            Write(state, records);
+        }
+        catch (...) {
+            failed = current_exception();
+        }
+        lk.lock();
+        busy = false;
+        error = failed;
+        cv.notify_all();
+    }
+}
+
+void CheckpointWriter::Write(const EvolutionState& state, const vector<HistoryRecord>& records) {
+    // History first: the state only counts records that are already on disk.
+    if (fwrite(records.data(), sizeof(HistoryRecord), records.size(), history) != records.size() || fflush(history) != 0) {
+        throw runtime_error("Cannot write checkpoint: " + HistoryPath(path));
+    }
+    written += records.size();
+
+    string temp = path + ".tmp";
+    FILE* out = fopen(temp.c_str(), "wb");
+    if (!out) throw runtime_error("Cannot write checkpoint: " + temp);
+    CheckpointHeader header{};
+    memcpy(header.magic, "IPDCKP2", 8);
+    header.key_size = static_cast<uint32_t>(key.size());
+    header.strategies = static_cast<uint32_t>(state.population.size());
+    header.generation = state.generation;
+    header.stopped = state.stopped ? 1 : 0;
+    header.history = written;
+    header.rng_size = static_cast<uint32_t>(state.rng.size());
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(key.data(), 1, key.size(), out);
+    fwrite(state.population.data(), sizeof(int), state.population.size(), out);
+    fwrite(state.rng.data(), 1, state.rng.size(), out);
+    if (fclose(out) != 0) {
+        remove(temp.c_str());
+        throw runtime_error("Cannot write checkpoint: " + temp);
+    }
+    filesystem::rename(temp, path);
+}
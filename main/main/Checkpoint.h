@@ -0,0 +1,70 @@
+#pragma once
+#include "Engine.h"
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Key of an evolution run: everything that decides its trajectory except the
+// number of generations, so a resumed run may go on for longer.
+std::string EvolutionCheckpointKey(const Config& config);
+
+// One strategy's line of one generation, as passed to ResultSink::OnGeneration.
+struct HistoryRecord {
+    int32_t generation;
+    uint32_t strategy;
+    int32_t population;
+    uint32_t reserved;
+    double mean_score;
+};
+
+// RunEvolution state between two generations.
+struct EvolutionState {
+    int generation = 0;         // next generation to run
+    bool stopped = false;       // the run ended early, nothing left to select from
+    std::vector<int> population;
+    std::string rng;            // selection/mutation mt19937, as written by operator<<
+};
+
+// Reads a checkpoint written by CheckpointWriter. False when there is none;
+// throws when it belongs to a different run or is damaged. history receives
+// every generation recorded up to state.generation.
+bool LoadCheckpoint(const std::string& path, const std::string& key, EvolutionState& state, std::vector<HistoryRecord>& history);
+
+// Writes checkpoints on a background thread so the generation loop only pays
+// for a copy of the state. A checkpoint is two files: path holds the key and
+// the state and is replaced atomically; path.history is append-only and the
+// state records how many of its records are valid, so a run killed at any
+// point resumes from the last complete checkpoint. Saves queued while a write
+// is running are merged, the newest state winning.
+class CheckpointWriter {
+private:
+    std::string path, key;
+    FILE* history = nullptr;
+    uint64_t written = 0;          // history records on disk
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool queued = false, busy = false, closing = false;
+    EvolutionState pending;
+    std::vector<HistoryRecord> pending_history;
+    std::exception_ptr error;
+    std::thread worker;
+
+    void Run();
+    void Write(const EvolutionState& state, const std::vector<HistoryRecord>& records);
+
+public:
+    // Continues after `kept` records of path.history (those LoadCheckpoint
+    // returned), dropping any written after the last complete checkpoint.
+    CheckpointWriter(const std::string& path, const std::string& key, uint64_t kept);
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Queues state with the history records produced since the previous Save.
+    void Save(const EvolutionState& state, std::vector<HistoryRecord> records);
+    // Waits for every queued checkpoint to reach disk; throws if a write failed.
+    void Flush();
+};
@@ -0,0 +1,127 @@
+#include "Counts.h"
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+
+namespace {
+
+struct CountsHeader {
+    char magic[8];        // "IPDCNT3"; 3 since MatchSeed mixes the seed on its own
+    uint32_t key_size;
+    uint32_t record_size;
+    uint64_t records;
+};
+
+uint64_t Fnv1a(const string& s) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+}
+
+string CountsCacheKey(const vector<string>& strategies, int rounds, double epsilon, const string& noise,
+    unsigned int seed, int repeats, const string& kernel) {
+    string key = "strategies=";
+    for (size_t k = 0; k < strategies.size(); ++k) key += (k ? "," : "") + strategies[k];
+    char tail[160];
+    snprintf(tail, sizeof(tail), ";rounds=%d;epsilon=%.17g;seed=%u;repeats=%d;kernel=", rounds, epsilon, seed, repeats);
+    return key + tail + kernel + ";noise=" + noise;
+}
+
+CountsCache::CountsCache(const string& dir, const string& key, uint64_t records) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.counts", static_cast<unsigned long long>(Fnv1a(key)));
+    filesystem::create_directories(dir);
+    path = (filesystem::path(dir) / name).string();
+    temp = path + ".tmp";
+
+    if (FILE* in = fopen(path.c_str(), "rb")) {
+        CountsHeader header{};
+        string stored;
+        if (fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "IPDCNT3", 8) == 0
+            && header.record_size == sizeof(OutcomeCounts) && header.records == records && header.key_size == key.size()) {
+            stored.resize(header.key_size);
+            if (fread(&stored[0], 1, stored.size(), in) != stored.size()) stored.clear();
+        }
+        if (stored == key) {
+            f = in;
+            hit = true;
+            return;
+        }
+        fclose(in);
+    }
+
+    f = fopen(temp.c_str(), "wb");
+    if (!f) throw runtime_error("Cannot write counts cache: " + temp);
+    CountsHeader header{};
+    memcpy(header.magic, "IPDCNT3", 8);
+    header.key_size = static_cast<uint32_t>(key.size());
+    header.record_size = sizeof(OutcomeCounts);
+    header.records = records;
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(key.data(), 1, key.size(), f);
+}
+
+CountsCache::~CountsCache() {
+    if (!f) return;
+    fclose(f);
+    if (!hit) remove(temp.c_str()); // never committed: drop the partial file
+}
+
+void CountsCache::Read(OutcomeCounts* out, size_t count) {
+    if (fread(out, sizeof(OutcomeCounts), count, f) != count) throw runtime_error("Truncated counts cache: " + path);
+}
+
+void CountsCache::Write(const OutcomeCounts* in, size_t count) {
+    fwrite(in, sizeof(OutcomeCounts), count, f);
+}
+
+void CountsCache::Commit() {
+    if (hit || !f) return;
+    bool ok = fclose(f) == 0;
+    f = nullptr;
+    if (!ok) {
+        remove(temp.c_str());
+        throw runtime_error("Cannot write counts cache: " + temp);
+    }
+    remove(path.c_str());
+    if (rename(temp.c_str(), path.c_str()) != 0) throw runtime_error("Cannot write counts cache: " + path);
+}
+
+uint64_t MatchCache::Context(const string& description) {
+    return Mix64(Fnv1a(description));
+}
+
+bool MatchCache::Find(uint64_t context, uint64_t stream, OutcomeCounts& out) {
+    auto it = index.find({ context, stream });
+    if (it == index.end()) {
+        ++misses;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    out = it->second->second;
+    ++hits;
+    return true;
+}
+
+void MatchCache::Insert(uint64_t context, uint64_t stream, const OutcomeCounts& counts) {
+    if (capacity == 0) return;
+    Key key{ context, stream };
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = counts;
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    if (entries.size() == capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(key, counts);
+    index.emplace(key, entries.begin());
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "common.h"
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+
+// Key of a tournament's simulated outcomes: everything that decides the moves,
+// but not the payoffs or SCB costs they are scored with.
+std::string CountsCacheKey(const std::vector<std::string>& strategies, int rounds, double epsilon, const std::string& noise,
+    unsigned int seed, int repeats, const std::string& kernel);
+
+// Outcome counts of a whole tournament on disk, one OutcomeCounts per match in
+// (rep, i, j) order, so a later run with the same key is rescored without
+// simulating. Files live in dir under a hash of the key; the header holds the
+// full key, so a hash collision reads as a miss. A file being written goes to a
+// temporary name and only takes the final name on Commit.
+class CountsCache {
+private:
+    FILE* f = nullptr;
+    std::string path, temp;
+    bool hit = false;
+
+public:
+    CountsCache(const std::string& dir, const std::string& key, uint64_t records);
+    ~CountsCache();
+    CountsCache(const CountsCache&) = delete;
+    CountsCache& operator=(const CountsCache&) = delete;
+
+    // True when a complete file for the key exists and Read can be used;
+    // otherwise the counts are to be passed to Write.
+    bool Hit() const { return hit; }
+    void Read(OutcomeCounts* out, size_t count);
+    void Write(const OutcomeCounts* in, size_t count);
+    void Commit();
+};
+
+// In-memory LRU cache of single match outcomes, shared by the jobs of a
+// service (see Service.h) so a match played by one job is not played again by
+// the next. A match is known by its context (a 64-bit hash of the pair's names,
+// rounds, noise and kernel, from Context) and the stream seed it was played
+// with, so nothing but the entries themselves grows with use. Not thread-safe:
+// Engine only uses it from the thread folding a tournament.
+class MatchCache {
+private:
+    struct Key {
+        uint64_t context;
+        uint64_t stream;
+        bool operator==(const Key& other) const { return context == other.context && stream == other.stream; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return std::hash<uint64_t>()(k.stream ^ (k.context * 0x9E3779B97F4A7C15ULL)); }
+    };
+    using Entries = std::list<std::pair<Key, OutcomeCounts>>;
+
+    size_t capacity;
+    Entries entries; // most recently used first
+    std::unordered_map<Key, Entries::iterator, KeyHash> index;
+
+public:
+    uint64_t hits = 0, misses = 0;
+
+    explicit MatchCache(size_t max_entries) : capacity(max_entries) {}
+    static uint64_t Context(const std::string& description);
+    bool Find(uint64_t context, uint64_t stream, OutcomeCounts& out);
+    void Insert(uint64_t context, uint64_t stream, const OutcomeCounts& counts);
+    size_t Size() const { return entries.size(); }
+};
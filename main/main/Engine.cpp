@@ -1,8 +1,12 @@
 #include "Engine.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Counts.h"
+#include "Instrument.h"
+#include "Plugin.h"
 #include <iostream>
 #include <vector>
 #include <string>
-#include <map>
 #include <algorithm>
 #include <cmath>
 
@@ -10,166 +14,458 @@ using namespace std;
 
 void set_global_seed(unsigned int seed);
 
-Engine::Engine(const Config& cfg) : config(cfg) {
+Engine::Engine(const Config& cfg, ThreadPool* shared_pool, MatchCache* shared_cache) : config(cfg), match_cache(shared_cache) {
     set_global_seed(config.seed);
     config.payoffs.Validate();
+    if (config.selection != "proportional" && config.selection != "wright-fisher" && config.selection != "moran") {
+        throw runtime_error("Unknown selection: " + config.selection);
+    }
+    if (config.update != "imitate" && config.update != "fermi") throw runtime_error("Unknown update: " + config.update);
+    if (config.temperature <= 0.0) throw runtime_error("Temperature must be positive");
+    if (config.trace && (config.fsm_batch || config.exact)) throw runtime_error("--trace needs per-match simulation; drop --fsm-batch and --exact");
+    if (config.resume && config.checkpoint.empty()) throw runtime_error("--resume needs --checkpoint");
+    if (!config.checkpoint.empty() && (!config.lattice.empty() || !config.graph.empty())) {
+        throw runtime_error("--checkpoint is supported for count-based evolution only");
+    }
+    if (config.noise != "execution" && config.noise != "perception") throw runtime_error("Unknown noise model: " + config.noise);
+    if (config.checkpoint_every < 1) throw runtime_error("Checkpoint interval must be at least one generation");
+    if (!config.shard.empty()) {
+        shard = ParseShard(config.shard);
+        if (config.evolve || !config.sweep.empty() || !config.space.empty() || config.target_ci > 0.0 || !config.counts_cache.empty()) {
+            throw runtime_error("--shard is supported for fixed-repeat tournaments without --counts-cache only");
+        }
+    }
+    if (config.target_ci > 0.0 && (config.trace || !config.counts_cache.empty() || !config.sweep.empty() || match_cache)) {
+        throw runtime_error("--target-ci is supported for standalone tournaments without --trace, --counts-cache or --sweep only");
+    }
+    for (const auto& path : config.plugins) LoadPlugin(path);
     for (const auto& name : config.strategies) {
         strategy_pool.push_back(CreateStrategy(name));
+        names.push_back(strategy_pool.back()->name());
+        plugin_pool.push_back(dynamic_cast<PluginStrategy*>(strategy_pool.back().get()) != nullptr);
+        builtin_pool.push_back(config.fast_path ? CreateBuiltin(name) : nullopt);
+        fsm_pool.push_back(config.fsm_batch || config.exact ? BuiltinFsm(name) : nullopt);
     }
+    own_epsilon.resize(names.size());
+    for (const auto& kv : config.player_epsilon) {
+        if (kv.second < 0.0 || kv.second > 1.0) throw runtime_error("Epsilon of " + kv.first + " must lie in [0, 1]");
+        bool found = false;
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (kv.first == names[i] || kv.first == config.strategies[i]) {
+                own_epsilon[i] = kv.second;
+                found = true;
+            }
+        }
+        if (!found) throw runtime_error("Epsilon given for a strategy not in the tournament: " + kv.first);
+    }
+    if (shared_pool) pool = shared_pool;
+    else if (config.threads != 1) pool = (own_pool = make_unique<ThreadPool>(config.threads)).get();
+    slot_players.resize(pool ? pool->Size() : 1);
+    pair_cache.resize(strategy_pool.size() * strategy_pool.size());
+    pair_cached.assign(pair_cache.size(), 0);
 }
 
-pair<double, double> RunMatch(Strategy& p1, Strategy& p2, int rounds, double epsilon, const PayoffMatrix<double>& payoffs) {
-    History p1_hist, p2_hist;
-    double p1_score = 0.0, p2_score = 0.0;
-    uniform_real_distribution<double> dist(0.0, 1.0);
+Engine::~Engine() = default;
+
+string NoiseKey(const Config& config) {
+    string key = config.noise;
+    char value[32];
+    for (const auto& kv : config.player_epsilon) {
+        snprintf(value, sizeof(value), "%.17g", kv.second);
+        key += "," + kv.first + "=" + value;
+    }
+    return key;
+}
+
+namespace {
+
+enum class NoisePath { None, Execution, Perception };
+
+Move Flip(Move m, uint64_t flip) { return static_cast<Move>(static_cast<int>(m) ^ static_cast<int>(flip)); }
+
+// Shared match loop, specialized on the noise model so a noise-free match draws
+// nothing from rng. With concrete final strategy types the decide() calls are
+// resolved at compile time and can be inlined; with Strategy it is the virtual path.
+template<NoisePath N, typename S1, typename S2>
+OutcomeCounts CountMatchT(S1& p1, S2& p2, int rounds, const Noise& noise, uint64_t* trace) {
+    // Reused across matches on this thread; clear() keeps the capacity.
+    // view1 / view2: the opponent's moves as player 1 / player 2 perceived them.
+    static thread_local MoveHistory p1_hist, p2_hist, view1, view2;
+    p1_hist.clear();
+    p2_hist.clear();
+    p1_hist.reserve(rounds);
+    p2_hist.reserve(rounds);
+    if (N == NoisePath::Perception) {
+        view1.clear();
+        view2.clear();
+        view1.reserve(rounds);
+        view2.reserve(rounds);
+    }
+    int outcomes[4] = {};
+    const uint64_t threshold1 = NoiseThreshold(noise.p1), threshold2 = NoiseThreshold(noise.p2);
+    uint64_t flips1 = 0, flips2 = 0;
 
     p1.reset();
     p2.reset();
+    RoundTimer timer;
 
     for (int i = 0; i < rounds; ++i) {
-        Move m1 = p1.decide(p1_hist, p2_hist);
-        Move m2 = p2.decide(p2_hist, p1_hist);
+        // Noise for the next 64 rounds is drawn up front, one bit per round and player.
+        int bit = i & 63;
+        if (N != NoisePath::None && bit == 0) {
+            NoiseMasks(rng, threshold1, threshold2, min(64, rounds - i), flips1, flips2);
+            timer.Lap(Phase::Noise);
+        }
 
-        if (dist(rng) < epsilon) m1 = (m1 == Move::C ? Move::D : Move::C);
-        if (dist(rng) < epsilon) m2 = (m2 == Move::C ? Move::D : Move::C);
+        Move m1, m2;
+        if (N == NoisePath::Perception) {
+            m1 = p1.decide(p1_hist, view1);
+            m2 = p2.decide(p2_hist, view2);
+        }
+        else {
+            m1 = p1.decide(p1_hist, p2_hist);
+            m2 = p2.decide(p2_hist, p1_hist);
+        }
+        timer.Lap(Phase::Decide);
 
-        auto scores = payoffs.Get_Scores(m1, m2);
-        p1_score += scores.first;
-        p2_score += scores.second;
+        if (N == NoisePath::Execution) {
+            m1 = Flip(m1, (flips1 >> bit) & 1);
+            m2 = Flip(m2, (flips2 >> bit) & 1);
+        }
+        outcomes[(m1 == Move::D) * 2 + (m2 == Move::D)]++;
 
         p1_hist.push_back(m1);
         p2_hist.push_back(m2);
+        if (N == NoisePath::Perception) {
+            view1.push_back(Flip(m2, (flips1 >> bit) & 1));
+            view2.push_back(Flip(m1, (flips2 >> bit) & 1));
+        }
+        timer.Lap(Phase::Outcome);
     }
-    return { p1_score, p2_score };
+    if (trace) {
+        size_t words = (static_cast<size_t>(rounds) + 63) / 64;
+        copy(p1_hist.view().data(), p1_hist.view().data() + words, trace);
+        copy(p2_hist.view().data(), p2_hist.view().data() + words, trace + words);
+    }
+    return { double(outcomes[0]), double(outcomes[1]), double(outcomes[2]), double(outcomes[3]) };
+}
+
+template<typename S1, typename S2>
+OutcomeCounts CountMatchNoise(S1& p1, S2& p2, int rounds, const Noise& noise, uint64_t* trace) {
+    if (noise.None()) return CountMatchT<NoisePath::None>(p1, p2, rounds, noise, trace);
+    if (noise.model == NoiseModel::Perception) return CountMatchT<NoisePath::Perception>(p1, p2, rounds, noise, trace);
+    return CountMatchT<NoisePath::Execution>(p1, p2, rounds, noise, trace);
 }
 
-vector<StrategyResult> Engine::RunTournament() {
-    map<string, vector<double>> all_scores;
-    for (const auto& s : strategy_pool) {
-        all_scores[s->name()] = {};
+}
+
+OutcomeCounts CountMatch(Strategy& p1, Strategy& p2, int rounds, const Noise& noise, uint64_t* trace) {
+    return CountMatchNoise(p1, p2, rounds, noise, trace);
+}
+
+// Instantiates CountMatchT for every pair of built-in types.
+OutcomeCounts CountBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, const Noise& noise, uint64_t* trace) {
+    if (&p1 == &p2) {
+        return visit([&](auto& s) { return CountMatchNoise(s, s, rounds, noise, trace); }, p1);
     }
+    return visit([&](auto& s1, auto& s2) { return CountMatchNoise(s1, s2, rounds, noise, trace); }, p1, p2);
+}
 
-    for (int rep = 0; rep < config.repeats; ++rep) {
-        for (size_t i = 0; i < strategy_pool.size(); ++i) {
-            for (size_t j = i; j < strategy_pool.size(); ++j) {
-                auto& p1 = *strategy_pool[i];
-                auto& p2 = *strategy_pool[j];
+OutcomeCounts CountMatch(Strategy& p1, Strategy& p2, int rounds, double epsilon, uint64_t* trace) {
+    return CountMatch(p1, p2, rounds, Noise{ epsilon, epsilon }, trace);
+}
 
-                auto scores = RunMatch(p1, p2, config.rounds, config.epsilon, config.payoffs);
+OutcomeCounts CountBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, double epsilon, uint64_t* trace) {
+    return CountBuiltinMatch(p1, p2, rounds, Noise{ epsilon, epsilon }, trace);
+}
 
-                if (i == j) { 
-                    all_scores[p1.name()].push_back(scores.first);
-                }
-                else {
-                    all_scores[p1.name()].push_back(scores.first);
-                    all_scores[p2.name()].push_back(scores.second);
-                }
-            }
+pair<double, double> RunMatch(Strategy& p1, Strategy& p2, int rounds, double epsilon, const PayoffMatrix<double>& payoffs) {
+    return CountMatch(p1, p2, rounds, epsilon).Score(payoffs);
+}
+
+pair<double, double> RunBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, double epsilon, const PayoffMatrix<double>& payoffs) {
+    return CountBuiltinMatch(p1, p2, rounds, epsilon).Score(payoffs);
+}
+
+PlayerSet& Engine::SlotPlayers() {
+    size_t slot = pool ? ThreadPool::CurrentSlot() : 0;
+    auto& own = slot_players[slot];
+    if (!own) {
+        own = make_unique<PlayerSet>();
+        for (const auto& prototype : strategy_pool) {
+            own->first.push_back(own->arena.Clone(*prototype));
+            own->second.push_back(own->arena.Clone(*prototype));
         }
     }
+    return *own;
+}
+
+Noise Engine::PairNoise(size_t i, size_t j) const {
+    Noise noise;
+    noise.p1 = own_epsilon[i].value_or(config.epsilon);
+    noise.p2 = own_epsilon[j].value_or(config.epsilon);
+    noise.model = config.noise == "perception" ? NoiseModel::Perception : NoiseModel::Execution;
+    return noise;
+}
 
-    vector<StrategyResult> results;
-    for (const auto& s : strategy_pool) {
-        results.push_back(StrategyResult::compute(s->name(), all_scores[s->name()]));
+bool Engine::TableKernel(size_t i, size_t j) const {
+    if (!fsm_pool[i] || !fsm_pool[j]) return false;
+    Noise noise = PairNoise(i, j);
+    return noise.p1 == noise.p2 && (noise.model == NoiseModel::Execution || noise.None());
+}
+
+OutcomeCounts Engine::PlayCounts(PlayerSet& players, size_t i, size_t j, uint64_t* trace) const {
+    if (builtin_pool[i] && builtin_pool[j]) {
+        // Fresh copies keep the match self-contained.
+        BuiltinStrategy p1 = *builtin_pool[i];
+        BuiltinStrategy p2 = *builtin_pool[j];
+        return CountBuiltinMatch(p1, p2, config.rounds, PairNoise(i, j), trace);
     }
-    return results;
+    return CountMatch(*players.first[i], *players.second[j], config.rounds, PairNoise(i, j), trace);
 }
 
+pair<double, double> Engine::PlayMatch(PlayerSet& players, size_t i, size_t j) const {
+    return PlayCounts(players, i, j).Score(config.payoffs);
+}
 
-double GetSCB_Cost(const string& name) {
-    if (name == "ALLC" || name == "ALLD" || name.rfind("RND", 0) == 0) return 1.0;
-    if (name == "TFT" || name == "GRIM" || name == "SUS_TFT") return 2.0;
-    if (name == "PAVLOV" || name == "CONTRITE" || name == "ADAPT_PUNISH") return 3.0;
-    if (name == "PROBER") return 4.0;
-    return 0.0;
+vector<StrategyResult> Engine::RunTournament(ResultSink* sink) {
+    if (sink) sink->Begin(names);
+    auto results = config.target_ci > 0.0 ? AdaptiveTournament(sink) : Tournament({ config.payoffs }, sink)[0];
+    if (sink) {
+        if (!shard.Active()) sink->OnLeaderboard(results);
+        sink->End();
+    }
+    return results;
 }
 
-vector<vector<StrategyResult>> Engine::RunEvolution() {
-    vector<vector<StrategyResult>> evolution_history;
+vector<vector<StrategyResult>> Engine::Tournament(const vector<PayoffMatrix<double>>& payoff_sets, ResultSink* sink) {
+    const size_t n = strategy_pool.size();
+    vector<pair<size_t, size_t>> pairings;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) {
+            pairings.emplace_back(i, j);
+        }
+    }
+    const size_t P = pairings.size();
 
-    vector<int> current_population(strategy_pool.size());
-    for (size_t i = 0; i < strategy_pool.size(); ++i) {
-        current_population[i] = config.population / strategy_pool.size();
+    // Statistics are folded per segment of (rep, i, j) matches, see Shard.h. A
+    // shard plays only the matches [first, last) of its segments.
+    const uint64_t total = static_cast<uint64_t>(config.repeats) * P;
+    const auto segments = shard.Segments((total + kFoldSegment - 1) / kFoldSegment);
+    const uint64_t first = segments.first * kFoldSegment, last = min(total, segments.second * kFoldSegment);
+    unique_ptr<ShardWriter> shard_file;
+    if (shard.Active()) {
+        shard_file = make_unique<ShardWriter>(ShardPath(config.output, shard), ShardKey(config, names), names, shard,
+            segments.first, segments.second);
     }
+    // Reps of pairing p in [rep_begin, rep_end) whose match lies in [first, last).
+    auto owned_reps = [&](size_t p, int rep_begin, int rep_end) {
+        uint64_t lo = first > p ? (first - p + P - 1) / P : 0, hi = last > p ? (last - p + P - 1) / P : 0;
+        return make_pair(static_cast<int>(max<uint64_t>(rep_begin, lo)), static_cast<int>(min<uint64_t>(rep_end, hi)));
+    };
 
-    for (int gen = 0; gen < config.generations; ++gen) {
-        map<string, double> total_scores;
-        for (const auto& s : strategy_pool) total_scores[s->name()] = 0.0;
+    // Traces need the moves, so they are always simulated.
+    const size_t trace_words = config.trace && sink ? 2 * ((static_cast<size_t>(config.rounds) + 63) / 64) : 0;
 
-        for (size_t i = 0; i < strategy_pool.size(); ++i) {
-            for (size_t j = i; j < strategy_pool.size(); ++j) {
-                if (current_population[i] == 0 || current_population[j] == 0) continue;
+    // Pairings where both sides have table forms are solved per pairing: in exact
+    // mode once for all repeats, otherwise as SIMD lanes seeded per (seed, rep, i, j).
+    // Pairings with a plugin side also run as lanes over the repeats.
+    vector<bool> batched(P, false);
+    vector<size_t> batch;
+    for (size_t p = 0; p < P; ++p) {
+        size_t i = pairings[p].first, j = pairings[p].second;
+        if (TableKernel(i, j) || ((plugin_pool[i] || plugin_pool[j]) && !trace_words)) {
+            batched[p] = true;
+            batch.push_back(p);
+        }
+    }
+    vector<OutcomeCounts> exact_counts(config.exact ? P : 0);
+    vector<char> exact_done(exact_counts.size(), 0);
 
-                auto& p1 = *strategy_pool[i];
-                auto& p2 = *strategy_pool[j];
-                auto scores = RunMatch(p1, p2, config.rounds, config.epsilon, config.payoffs);
+    vector<double> scb_cost(n, 0.0);
+    if (config.apply_scb) {
+        for (size_t i = 0; i < n; ++i) scb_cost[i] = GetSCB_Cost(names[i]);
+    }
 
-                if (i == j) {
-                    total_scores[p1.name()] += scores.first * current_population[i];
-                }
-                else {
-                    total_scores[p1.name()] += scores.first * current_population[i] * current_population[j];
-                    total_scores[p2.name()] += scores.second * current_population[j] * current_population[i];
+    unique_ptr<CountsCache> cache;
+    if (!config.counts_cache.empty()) {
+        string kernel = config.exact ? "exact" : config.fsm_batch ? "fsm-batch" : "match";
+        cache = make_unique<CountsCache>(config.counts_cache,
+            CountsCacheKey(names, config.rounds, config.epsilon, NoiseKey(config), config.seed, config.repeats, kernel),
+            static_cast<uint64_t>(config.repeats) * P);
+    }
+    const bool from_cache = cache && cache->Hit() && !(config.trace && sink);
+
+    // Repeats run in blocks: every (rep, i, j) match in a block owns an RNG stream
+    // and a result slot, so the block can run in any order on any thread with
+    // bit-identical results, and memory stays bounded by the block size.
+    const size_t block_reps = max<size_t>(1, min<size_t>(config.repeats, (1 << 16) / P));
+    vector<OutcomeCounts> match_counts(block_reps * P);
+
+    // Outcomes already played by other jobs of a service. A match is looked up
+    // by its pairing's context and stream seed; exact outcomes need no stream.
+    // Plugin strategies are never cached: their names say nothing about the code
+    // behind them, which another job may have loaded from a different library.
+    MatchCache* shared = trace_words || from_cache ? nullptr : match_cache;
+    vector<uint64_t> contexts;
+    vector<char> cached, shared_hit(shared ? match_counts.size() : 0, 0);
+    if (shared) {
+        char settings[128];
+        for (const auto& pairing : pairings) {
+            size_t i = pairing.first, j = pairing.second;
+            cached.push_back(!plugin_pool[i] && !plugin_pool[j]);
+            Noise noise = PairNoise(i, j);
+            const char* kernel = !TableKernel(i, j) ? "match" : config.exact ? "exact" : "fsm-batch";
+            snprintf(settings, sizeof(settings), "\n%d\n%.17g\n%.17g\n%d\n%s", config.rounds, noise.p1, noise.p2,
+                static_cast<int>(noise.model), kernel);
+            contexts.push_back(shared->Context(names[i] + "\n" + names[j] + settings));
+        }
+    }
+    auto shared_stream = [&](size_t p, int rep) {
+        return config.exact && TableKernel(pairings[p].first, pairings[p].second)
+            ? 0 : MatchSeed(config.seed, rep, pairings[p].first, pairings[p].second);
+    };
+    vector<uint64_t> traces(block_reps * P * trace_words);
+    int rep_begin = 0, rep_end = 0;
+
+    auto play_batch = [&](size_t begin, size_t end) {
+        vector<uint64_t> seeds(rep_end - rep_begin);
+        vector<OutcomeCounts> lane_counts(rep_end - rep_begin);
+        for (size_t b = begin; b < end; ++b) {
+            size_t p = batch[b];
+            size_t i = pairings[p].first, j = pairings[p].second;
+            auto reps = owned_reps(p, rep_begin, rep_end);
+            if (reps.first >= reps.second) continue;
+            size_t lanes = reps.second - reps.first, base = reps.first - rep_begin;
+            if (shared) {
+                bool all_hit = true;
+                for (size_t k = 0; k < lanes && all_hit; ++k) all_hit = shared_hit[(base + k) * P + p] != 0;
+                if (all_hit) continue;
+            }
+            for (size_t k = 0; k < lanes; ++k) seeds[k] = MatchSeed(config.seed, reps.first + k, i, j);
+            if (!TableKernel(i, j)) {
+                PairTimer timer(i, j, config.rounds, lanes);
+                auto& arena = SlotPlayers().lanes;
+                vector<Strategy*> a(lanes), b(lanes);
+                for (size_t k = 0; k < lanes; ++k) {
+                    a[k] = arena.Clone(*strategy_pool[i]);
+                    b[k] = arena.Clone(*strategy_pool[j]);
                 }
+                CountMatchLanes(a.data(), b.data(), lanes, config.rounds, PairNoise(i, j), seeds.data(), lane_counts.data());
+                arena.Reset();
+                for (size_t k = 0; k < lanes; ++k) match_counts[(base + k) * P + p] = lane_counts[k];
+                continue;
+            }
+            PhaseScope phase(Phase::FsmBatch);
+            PairTimer timer(i, j, config.rounds, lanes);
+            if (config.exact) {
+                if (!exact_done[p]) exact_counts[p] = ExactFsmCounts(*fsm_pool[i], *fsm_pool[j], config.rounds, PairNoise(i, j).p1);
+                exact_done[p] = 1;
+                fill(lane_counts.begin(), lane_counts.begin() + lanes, exact_counts[p]);
+            }
+            else {
+                CountFsmBatch(*fsm_pool[i], *fsm_pool[j], config.rounds, PairNoise(i, j).p1, seeds.data(), lanes, lane_counts.data());
             }
+            for (size_t k = 0; k < lanes; ++k) match_counts[(base + k) * P + p] = lane_counts[k];
+        }
+    };
+
+    auto play = [&](size_t begin, size_t end) {
+        auto& players = SlotPlayers();
+
+        for (size_t m = begin; m < end; ++m) {
+            size_t p = m % P;
+            if (batched[p] || (shared && shared_hit[m])) continue;
+            size_t i = pairings[p].first, j = pairings[p].second;
+            PairTimer timer(i, j, config.rounds);
+            Seed_Match_Stream(MatchSeed(config.seed, rep_begin + m / P, i, j));
+            match_counts[m] = PlayCounts(players, i, j, trace_words ? &traces[m * trace_words] : nullptr);
         }
+    };
 
-        vector<StrategyResult> gen_results;
-        double total_fitness = 0;
-        for (size_t i = 0; i < strategy_pool.size(); ++i) {
-            if (current_population[i] == 0) continue;
-            StrategyResult res;
-            res.name = strategy_pool[i]->name();
-            res.population = current_population[i];
-            res.mean_score = total_scores[res.name] / res.population;
-            if (config.apply_scb) res.mean_score -= GetSCB_Cost(res.name);
-            total_fitness += res.mean_score * res.population;
-            gen_results.push_back(res);
-        }
-        evolution_history.push_back(gen_results);
-
-        if (total_fitness <= 0) break;
-
-        vector<int> next_population(strategy_pool.size(), 0);
-        int reproduced_count = 0;
-        for (const auto& res : gen_results) {
-            double proportion = (res.mean_score * res.population) / total_fitness;
-            int num_offspring = static_cast<int>(round(proportion * config.population));
-            auto it = find_if(strategy_pool.begin(), strategy_pool.end(), [&](const auto& s) { return s->name() == res.name; });
-            size_t idx = distance(strategy_pool.begin(), it);
-            next_population[idx] = num_offspring;
-            reproduced_count += num_offspring;
-        }
-
-        while (reproduced_count < config.population) {
-            next_population[rng() % strategy_pool.size()]++;
-            reproduced_count++;
-        }
-        while (reproduced_count > config.population) {
-            size_t idx = rng() % strategy_pool.size();
-            if (next_population[idx] > 0) {
-                next_population[idx]--;
-                reproduced_count--;
+    vector<vector<RunningStats>> stats(payoff_sets.size(), vector<RunningStats>(n));
+    vector<vector<RunningStats>> segment(payoff_sets.size(), vector<RunningStats>(n));
+    uint64_t current_segment = segments.first;
+    auto end_segment = [&]() {
+        for (size_t k = 0; k < payoff_sets.size(); ++k) {
+            for (size_t i = 0; i < n; ++i) stats[k][i].Merge(segment[k][i]);
+        }
+        if (shard_file) shard_file->Add(segment[0]);
+        for (auto& s : segment) fill(s.begin(), s.end(), RunningStats());
+        ++current_segment;
+    };
+
+    for (rep_begin = 0; rep_begin < config.repeats; rep_begin = rep_end) {
+        rep_end = static_cast<int>(min<size_t>(config.repeats, rep_begin + block_reps));
+        size_t block_matches = (rep_end - rep_begin) * P;
+        // This shard's part of the block, as offsets into it.
+        uint64_t block_first = static_cast<uint64_t>(rep_begin) * P;
+        size_t own_begin = static_cast<size_t>(min<uint64_t>(block_matches, first > block_first ? first - block_first : 0));
+        size_t own_end = static_cast<size_t>(min<uint64_t>(block_matches, last > block_first ? last - block_first : 0));
+        if (own_begin >= own_end) continue;
+        auto play_owned = [&](size_t begin, size_t end) { play(own_begin + begin, own_begin + end); };
+        if (shared) {
+            for (size_t m = own_begin; m < own_end; ++m) {
+                shared_hit[m] = cached[m % P] && shared->Find(contexts[m % P], shared_stream(m % P, rep_begin + static_cast<int>(m / P)), match_counts[m]);
+            }
+        }
+        if (from_cache) {
+            cache->Read(match_counts.data(), block_matches);
+        }
+        else if (pool) {
+            pool->ParallelFor(batch.size(), 1, play_batch);
+            size_t grain = max<size_t>(1, (own_end - own_begin) / (pool->Size() * 16));
+            pool->ParallelFor(own_end - own_begin, grain, play_owned);
+        }
+        else {
+            play_batch(0, batch.size());
+            play_owned(0, own_end - own_begin);
+        }
+        if (cache && !cache->Hit()) cache->Write(match_counts.data(), block_matches);
+        if (shared) {
+            for (size_t m = own_begin; m < own_end; ++m) {
+                if (cached[m % P] && !shared_hit[m]) shared->Insert(contexts[m % P], shared_stream(m % P, rep_begin + static_cast<int>(m / P)), match_counts[m]);
             }
         }
 
-        uniform_real_distribution<double> mut_dist(0.0, 1.0);
-        for (int i = 0; i < config.population; ++i) {
-            if (mut_dist(rng) < config.mutation) {
-                int count = 0;
-                size_t current_idx = 0;
-                for (size_t k = 0; k < next_population.size(); ++k) {
-                    count += next_population[k];
-                    if (i < count) { current_idx = k; break; }
-                }
+        // Fold in (rep, i, j) order so the statistics never depend on scheduling.
+        PhaseScope phase(Phase::Fold);
+        for (size_t m = own_begin; m < own_end; ++m) {
+            if ((block_first + m) / kFoldSegment != current_segment) end_segment();
+            size_t i = pairings[m % P].first, j = pairings[m % P].second;
+            int rep = rep_begin + static_cast<int>(m / P);
+            if (trace_words) sink->OnTrace(rep, i, j, config.rounds, &traces[m * trace_words]);
+            for (size_t k = 0; k < payoff_sets.size(); ++k) {
+                auto scores = match_counts[m].Score(payoff_sets[k]);
+                scores.first -= scb_cost[i];
+                scores.second -= scb_cost[j];
+                if (sink && k == 0) sink->OnMatch(rep, i, j, scores.first, scores.second);
 
-                if (next_population[current_idx] > 0) {
-                    next_population[current_idx]--;
-                    next_population[rng() % strategy_pool.size()]++;
-                }
+                segment[k][i].Push(scores.first);
+                if (i != j) segment[k][j].Push(scores.second);
             }
         }
-        current_population = next_population;
     }
-    return evolution_history;
-}
\ No newline at end of file
+    if (first < last) end_segment();
+
+    if (cache) cache->Commit();
+    if (shard_file) shard_file->Commit();
+
+    vector<vector<StrategyResult>> results(payoff_sets.size());
+    for (size_t k = 0; k < payoff_sets.size(); ++k) {
+        for (size_t i = 0; i < n; ++i) {
+            results[k].push_back(StrategyResult::compute(names[i], stats[k][i]));
+            results[k].back().strategy = i;
+        }
+    }
+    return results;
+}
+
+
+double GetSCB_Cost(const string& name) {
+    if (name == "ALLC" || name == "ALLD" || name.rfind("RND", 0) == 0) return 1.0;
+    if (name == "TFT" || name == "GRIM" || name == "SUS_TFT") return 2.0;
+    if (name == "PAVLOV" || name == "CONTRITE" || name == "ADAPT_PUNISH") return 3.0;
+    if (name == "PROBER") return 4.0;
+    return 0.0;
+}
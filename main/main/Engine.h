@@ -1,28 +1,195 @@
 #pragma once
 #pragma once
-#include "Strategy.h"
+#include "Strategies.h"
+#include "Fsm.h"
+#include "Arena.h"
+#include "Shard.h"
 #include <map>
 
+class ThreadPool;
+class ResultSink;
+class MatchCache;
+
+// One worker's strategy instances, cloned from the engine's prototypes into its
+// own arena: first[i] plays strategy i as the first player and second[j] plays j
+// as the second, so a strategy playing itself has two independent states.
+// lanes holds the short-lived clones of a batched pairing.
+struct PlayerSet {
+    StrategyArena arena, lanes;
+    std::vector<Strategy*> first, second;
+};
+
 struct Config {
     int rounds = 100, repeats = 10, population = 50, generations = 50;
     unsigned int seed = 0;
+    unsigned int threads = 1; // 0 = all hardware threads
     double epsilon = 0.0, mutation = 0.01;
+    std::string noise = "execution";                // noise model: execution or perception, see Noise
+    std::map<std::string, double> player_epsilon;   // per-strategy epsilon overriding epsilon
+    std::string selection = "proportional"; // evolution update: proportional, wright-fisher or moran
+    // Fixation probabilities (RunFixation) in a Moran process of `population` individuals.
+    bool fixation = false;
+    double selection_strength = 0.1;  // w in fitness exp(w * payoff per round)
+    double fixation_ci = 0.001;       // target 95% half-width of each probability
+    uint64_t fixation_trials = 10000000; // cap per ordered pair
+    // Spatial evolution: one strategy per node of a lattice or graph, matches only along edges.
+    std::string lattice;            // "WxH" torus
+    std::string graph;              // edge-list file
+    bool moore = false;             // 8-neighbour lattice instead of 4
+    std::string update = "imitate"; // spatial update: imitate (best neighbour) or fermi
+    double temperature = 0.1;       // selection noise of the fermi update
+    std::string sweep;              // grid spec for RunSweep, see ParseSweepGrid
+    bool trace = false;             // stream each tournament match's moves to the sink
+    std::string counts_cache;       // directory of cached tournament outcome counts, see CountsCache
+    double target_ci = 0.0;         // adaptive repeats: 95% CI half-width to reach, in payoff per round
+    int max_repeats = 100000;       // adaptive repeats: cap per pairing
+    std::string checkpoint;         // RunEvolution checkpoint file, see CheckpointWriter
+    int checkpoint_every = 100;     // generations between checkpoints
+    bool resume = false;            // continue from checkpoint if it exists
+    std::vector<std::string> plugins; // strategy libraries to load, see IpdPlugin.h
+    std::string stats;              // instrumentation report to stderr after the run: text or json
+    std::string shard;              // "k/N": play only shard k of the tournament, see Shard.h
+    std::vector<std::string> merge; // shard files to merge into one leaderboard
+    std::string serve;              // Unix socket to serve jobs on, see Service.h
+    size_t cache_entries = 1 << 20; // service: match outcomes kept in its MatchCache
+    std::string space;              // strategy space for RunSpaceTournament, see ParseStrategySpace
+    int top_k = 20;                 // space tournament: leaderboard length
+    std::string payoff_matrix;      // space tournament: payoff matrix file, see Space.h
     PayoffMatrix<double> payoffs;
     std::vector<std::string> strategies;
     bool evolve = false;
     bool apply_scb = false;
+    bool fast_path = false; // statically dispatched kernels for built-in pairs
+    bool fsm_batch = false; // SIMD lanes over the repeats of table-form pairs
+    bool exact = false;     // closed-form / expected scores for table-form pairs
     std::string format = "text";
+    std::string output = "results"; // base path for csv/jsonl/binary tables
+};
+
+// Strategy complexity cost subtracted from evolutionary fitness under --scb.
+double GetSCB_Cost(const std::string& name);
+
+// The noise settings other than epsilon, for keys of stored results.
+std::string NoiseKey(const Config& config);
+
+// One point of a parameter sweep.
+struct SweepPoint {
+    int rounds = 100;
+    double epsilon = 0.0;
+    PayoffMatrix<double> payoffs;
 };
 
+// Expands a grid spec into its points (the cross product of the axes, last axis
+// fastest). Axes are separated by ';' or newlines, e.g.
+//   rounds=100,200;epsilon=0:0.05:0.01;payoffs=5/3/1/0,4/3/1/0
+// Numeric values are lists of numbers or start:stop:step ranges; payoff matrices
+// are T/R/P/S. Axes left out take their value from base. "@file" reads the spec from a file.
+std::vector<SweepPoint> ParseSweepGrid(const std::string& spec, const Config& base);
+
+// Plays one match and returns its outcome counts. Noise and RND draw from the
+// calling thread's rng; a noise-free match draws nothing for noise. With a trace,
+// the moves actually played are also written there packed as in MoveHistory:
+// (rounds + 63) / 64 words for p1, then as many for p2.
+OutcomeCounts CountMatch(Strategy& p1, Strategy& p2, int rounds, const Noise& noise, uint64_t* trace = nullptr);
+OutcomeCounts CountBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, const Noise& noise, uint64_t* trace = nullptr);
+// Symmetric execution noise epsilon.
+OutcomeCounts CountMatch(Strategy& p1, Strategy& p2, int rounds, double epsilon, uint64_t* trace = nullptr);
+OutcomeCounts CountBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, double epsilon, uint64_t* trace = nullptr);
+
+// As above, scored: both players' total scores.
+std::pair<double, double> RunMatch(Strategy& p1, Strategy& p2, int rounds, double epsilon, const PayoffMatrix<double>& payoffs);
+std::pair<double, double> RunBuiltinMatch(BuiltinStrategy& p1, BuiltinStrategy& p2, int rounds, double epsilon, const PayoffMatrix<double>& payoffs);
+
 class Engine {
 private:
     Config config;
+    // Prototypes: never played, only cloned into each worker's PlayerSet.
     std::vector<std::unique_ptr<Strategy>> strategy_pool;
+    std::vector<std::string> names;
+    // Value copies of the built-ins for the fast path; empty for other strategies.
+    std::vector<std::optional<BuiltinStrategy>> builtin_pool;
+    // Table forms for the batched and exact kernels; empty for strategies without one.
+    std::vector<std::optional<FsmStrategy>> fsm_pool;
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    // Tournament outcomes shared with other engines, see MatchCache.
+    MatchCache* match_cache = nullptr;
+    // Strategies carry per-match state, so each pool slot plays with its own instances.
+    std::vector<std::unique_ptr<PlayerSet>> slot_players;
+    PlayerSet& SlotPlayers();
+
+    // Strategies from plugins; their pairings are played as lanes over the repeats
+    // so each round is one batched call per plugin side.
+    std::vector<char> plugin_pool;
+
+    // config.player_epsilon by strategy index; empty where config.epsilon applies.
+    std::vector<std::optional<double>> own_epsilon;
+    ShardSpec shard;
+    Noise PairNoise(size_t i, size_t j) const;
+    // Both sides have table forms and the noise is symmetric execution noise,
+    // the only kind the batched and exact kernels model.
+    bool TableKernel(size_t i, size_t j) const;
+
+    // Scores of pairs whose outcome never changes (noise-free deterministic, or
+    // exact mode), computed once. Index i * n + j; safe to fill from several threads.
+    std::vector<std::pair<double, double>> pair_cache;
+    std::vector<char> pair_cached;
+    bool PairCacheable(size_t i, size_t j) const;
+    std::pair<double, double> PlayPair(PlayerSet& players, size_t i, size_t j, uint64_t stream);
+    OutcomeCounts PlayCounts(PlayerSet& players, size_t i, size_t j, uint64_t* trace = nullptr) const;
+    std::pair<double, double> PlayMatch(PlayerSet& players, size_t i, size_t j) const;
+    // Round robin at config.rounds and config.epsilon: every match is played once (or
+    // read from config.counts_cache) and scored under each of payoff_sets, less the
+    // SCB costs under --scb, giving one leaderboard per matrix. Matches and traces go
+    // to sink (scored under payoff_sets[0]) when one is given.
+    std::vector<std::vector<StrategyResult>> Tournament(const std::vector<PayoffMatrix<double>>& payoff_sets, ResultSink* sink);
+    // Repeats [rep_begin, rep_end) of pairing (i, j), seeded as in Tournament.
+    void PlayReps(size_t i, size_t j, int rep_begin, int rep_end, OutcomeCounts* out);
+    std::vector<StrategyResult> AdaptiveTournament(ResultSink* sink);
+    // Score of i against j for every pair of living types (row-major n x n), in parallel.
+    void EvaluatePairs(const std::vector<int>& population, int generation, std::vector<double>& payoff);
 
 public:
-    Engine(const Config& cfg);
+    // The jobs of a service share one thread pool (config.threads is then
+    // ignored) and one match cache; a standalone engine has neither.
+    Engine(const Config& cfg, ThreadPool* shared_pool = nullptr, MatchCache* shared_cache = nullptr);
+    ~Engine();
+
+    // With a sink, every match is streamed to it in (rep, i, j) order and the
+    // leaderboard is passed on at the end. With config.target_ci the repeats are
+    // scheduled adaptively instead, see Adaptive.cpp. With config.shard only the
+    // shard's matches are played and its partial statistics written to
+    // ShardPath(config.output); the sink gets those matches but no leaderboard,
+    // and the returned leaderboard covers the shard alone.
+    std::vector<StrategyResult> RunTournament(ResultSink* sink = nullptr);
+
+    // With a sink, each generation is streamed to it and not kept in the
+    // returned history, so memory stays constant in the number of generations.
+    std::vector<std::vector<StrategyResult>> RunEvolution(ResultSink* sink = nullptr);
+
+    // Evolution on config.lattice or config.graph. Every node plays each neighbour
+    // once per generation, and a pair's scores are kept until one of the two nodes
+    // changes strategy. Results per generation are as in RunEvolution, with
+    // mean_score the mean total payoff of the nodes playing that strategy.
+    std::vector<std::vector<StrategyResult>> RunSpatialEvolution(ResultSink* sink = nullptr);
+
+    // A tournament at every point, all in this engine and its thread pool. Points
+    // sharing rounds and epsilon are simulated once: strategies only see the move
+    // history, so the matches do not depend on the payoffs and are rescored for each
+    // matrix. Each point's leaderboard equals a standalone run with the same seed.
+    std::vector<std::vector<StrategyResult>> RunSweep(const std::vector<SweepPoint>& points, ResultSink* sink = nullptr);
+
+    // Round robin over config.space instead of config.strategies, evaluated on the
+    // encoded tables in cache-sized tiles (see Space.h). Each pair is scored once,
+    // exactly: expected scores under noise or for stochastic strategies. The matrix
+    // goes to config.payoff_matrix when set; the config.top_k best are returned.
+    std::vector<StrategyResult> RunSpaceTournament(ResultSink* sink = nullptr);
 
-    std::vector<StrategyResult> RunTournament();
+    // Fixation probability of one mutant of each strategy in a population of every
+    // other, by parallel Monte Carlo runs of a frequency-dependent Moran process
+    // with as many trials as a pilot run says config.fixation_ci needs; see Fixation.cpp.
+    // Payoffs are a table of mean scores over config.repeats matches per pairing.
+    std::vector<FixationResult> RunFixation(ResultSink* sink = nullptr);
 
-    std::vector<std::vector<StrategyResult>> RunEvolution();
+    const std::vector<std::string>& Names() const { return names; }
 };
\ No newline at end of file
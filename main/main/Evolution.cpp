@@ -0,0 +1,310 @@
+#include "Engine.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Instrument.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+// Matches inside evolution use their own family of streams, apart from the tournament's.
+const uint64_t kEvolutionStream = 0x45564F4C5645ULL;
+
+// Draws k ~ Binomial(trials, p), clamping p into [0, 1].
+int Binomial(int trials, double p, mt19937& rng) {
+    if (trials <= 0 || p <= 0.0) return 0;
+    if (p >= 1.0) return trials;
+    return binomial_distribution<int>(trials, p)(rng);
+}
+
+// The original update: offspring proportional to total fitness, rounded, with
+// random single-individual corrections until the size is exact again.
+vector<int> SelectProportional(const vector<int>& population, const vector<double>& fitness, double total_fitness,
+    int target, mt19937& rng) {
+    PhaseScope phase(Phase::Selection);
+    vector<int> next(population.size(), 0);
+    int reproduced_count = 0;
+    for (size_t i = 0; i < population.size(); ++i) {
+        if (population[i] == 0) continue;
+        double proportion = (fitness[i] * population[i]) / total_fitness;
+        next[i] = static_cast<int>(round(proportion * target));
+        reproduced_count += next[i];
+    }
+
+    while (reproduced_count < target) {
+        next[rng() % next.size()]++;
+        reproduced_count++;
+    }
+    while (reproduced_count > target) {
+        size_t idx = rng() % next.size();
+        if (next[idx] > 0) {
+            next[idx]--;
+            reproduced_count--;
+        }
+    }
+    return next;
+}
+
+// Wright-Fisher: the next generation is a multinomial sample of `target`
+// individuals weighted by n_i * f_i, drawn as a chain of binomials in O(types).
+vector<int> SelectWrightFisher(const vector<int>& population, const vector<double>& fitness, int target, mt19937& rng) {
+    PhaseScope phase(Phase::Selection);
+    vector<double> weight(population.size());
+    double remaining_weight = 0.0;
+    size_t last = population.size();
+    for (size_t i = 0; i < population.size(); ++i) {
+        weight[i] = population[i] * max(0.0, fitness[i]);
+        remaining_weight += weight[i];
+        if (weight[i] > 0.0) last = i;
+    }
+
+    vector<int> next(population.size(), 0);
+    int remaining = target;
+    for (size_t i = 0; i < last && remaining > 0; ++i) {
+        if (weight[i] <= 0.0) continue;
+        // remaining_weight is a running difference, so rounding can leave it a
+        // little off: clamp, and give the last type whatever is left.
+        next[i] = Binomial(remaining, clamp(weight[i] / remaining_weight, 0.0, 1.0), rng);
+        remaining -= next[i];
+        remaining_weight -= weight[i];
+    }
+    if (last < population.size()) next[last] = remaining;
+    return next;
+}
+
+// Moran process: `target` birth-death events. The parent is drawn proportional
+// to n_i * f_i, the individual that dies uniformly. Fitness is frequency
+// dependent, f_i = payoff(i, i) + sum_{j != i} payoff(i, j) * n_j, and is
+// updated incrementally after each event, so an event costs O(types).
+vector<int> SelectMoran(const vector<int>& population, vector<double> fitness, const vector<double>& payoff,
+    int target, mt19937& rng) {
+    PhaseScope phase(Phase::Selection);
+    const size_t n = population.size();
+    vector<int> next = population;
+    int size = accumulate(next.begin(), next.end(), 0);
+    if (size == 0) return next;
+    uniform_real_distribution<double> uni(0.0, 1.0);
+
+    for (int event = 0; event < target; ++event) {
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) total += next[i] * max(0.0, fitness[i]);
+        if (total <= 0.0) break;
+
+        double pick = uni(rng) * total;
+        size_t birth = n;
+        for (size_t i = 0; i < n && birth == n; ++i) {
+            if (next[i] == 0) continue;
+            pick -= next[i] * max(0.0, fitness[i]);
+            if (pick < 0.0) birth = i;
+        }
+        if (birth == n) {
+            // Rounding left pick just above zero: take the last type that can reproduce.
+            for (size_t i = n; i-- > 0 && birth == n;) if (next[i] > 0 && fitness[i] > 0.0) birth = i;
+        }
+
+        int victim = uniform_int_distribution<int>(0, size - 1)(rng);
+        size_t death = 0;
+        while (victim >= next[death]) victim -= next[death++];
+
+        if (birth == death) continue;
+        next[birth]++;
+        next[death]--;
+        for (size_t i = 0; i < n; ++i) {
+            if (i != birth) fitness[i] += payoff[i * n + birth];
+            if (i != death) fitness[i] -= payoff[i * n + death];
+        }
+    }
+
+    // Grow or shrink to the target size (only when the population size changes).
+    while (size < target) { next[rng() % n]++; size++; }
+    while (size > target) {
+        size_t idx = rng() % n;
+        if (next[idx] > 0) { next[idx]--; size--; }
+    }
+    return next;
+}
+
+// Each individual mutates with probability `rate` into a uniformly random type
+// (possibly its own): Binomial(n_i, rate) mutants leave each type, and the
+// mutants are spread uniformly with a multinomial chain, O(types) per generation.
+void Mutate(vector<int>& population, double rate, mt19937& rng) {
+    PhaseScope phase(Phase::Mutation);
+    int mutants = 0;
+    for (auto& count : population) {
+        int k = Binomial(count, rate, rng);
+        count -= k;
+        mutants += k;
+    }
+    for (size_t i = 0; i < population.size() && mutants > 0; ++i) {
+        int k = Binomial(mutants, 1.0 / (population.size() - i), rng);
+        population[i] += k;
+        mutants -= k;
+    }
+}
+
+}
+
+bool Engine::PairCacheable(size_t i, size_t j) const {
+    return (config.exact && TableKernel(i, j))
+        || (PairNoise(i, j).None() && strategy_pool[i]->is_deterministic() && strategy_pool[j]->is_deterministic());
+}
+
+pair<double, double> Engine::PlayPair(PlayerSet& players, size_t i, size_t j, uint64_t stream) {
+    if (!PairCacheable(i, j)) {
+        Seed_Match_Stream(stream);
+        return PlayMatch(players, i, j);
+    }
+
+    size_t key = i * strategy_pool.size() + j;
+    if (!pair_cached[key]) {
+        pair_cache[key] = config.exact && TableKernel(i, j)
+            ? ExactFsmMatch(*fsm_pool[i], *fsm_pool[j], config.rounds, PairNoise(i, j).p1, config.payoffs)
+            : PlayMatch(players, i, j);
+        pair_cached[key] = 1;
+    }
+    return pair_cache[key];
+}
+
+void Engine::EvaluatePairs(const vector<int>& population, int generation, vector<double>& payoff) {
+    const size_t n = strategy_pool.size();
+    vector<pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) {
+            if (population[i] > 0 && population[j] > 0) pairs.emplace_back(i, j);
+        }
+    }
+
+    PhaseScope phase(Phase::Evaluate);
+    auto evaluate = [&](size_t begin, size_t end) {
+        auto& players = SlotPlayers();
+        for (size_t k = begin; k < end; ++k) {
+            size_t i = pairs[k].first, j = pairs[k].second;
+            PairTimer timer(i, j, config.rounds);
+            auto scores = PlayPair(players, i, j, MatchSeed(config.seed ^ kEvolutionStream, generation, i, j));
+            payoff[j * n + i] = scores.second;
+            payoff[i * n + j] = scores.first;
+        }
+    };
+    if (pool) pool->ParallelFor(pairs.size(), 1, evaluate);
+    else evaluate(0, pairs.size());
+}
+
+vector<vector<StrategyResult>> Engine::RunEvolution(ResultSink* sink) {
+    vector<vector<StrategyResult>> evolution_history;
+    if (sink) sink->Begin(names);
+
+    const size_t n = strategy_pool.size();
+    // Selection and mutation have their own generator; matches use per-(generation, i, j) streams.
+    mt19937 evo_rng(config.seed);
+
+    vector<double> scb_cost(n, 0.0);
+    if (config.apply_scb) {
+        for (size_t i = 0; i < n; ++i) scb_cost[i] = GetSCB_Cost(names[i]);
+    }
+
+    vector<int> current_population(n);
+    for (size_t i = 0; i < n; ++i) {
+        current_population[i] = config.population / static_cast<int>(n);
+    }
+
+    // Every match is seeded from its (generation, i, j) stream, so the population
+    // and evo_rng are all the state that crosses a generation boundary.
+    int first_generation = 0;
+    bool stopped = false;
+    unique_ptr<CheckpointWriter> checkpoint;
+    vector<HistoryRecord> unsaved;
+    if (!config.checkpoint.empty()) {
+        string key = EvolutionCheckpointKey(config);
+        EvolutionState state;
+        vector<HistoryRecord> history;
+        if (config.resume && LoadCheckpoint(config.checkpoint, key, state, history)) {
+            // Replay the finished generations so the output matches an uninterrupted run.
+            for (size_t k = 0; k < history.size();) {
+                int gen = history[k].generation;
+                vector<StrategyResult> gen_results;
+                for (; k < history.size() && history[k].generation == gen; ++k) {
+                    StrategyResult res;
+                    res.name = names.at(history[k].strategy);
+                    res.strategy = history[k].strategy;
+                    res.population = history[k].population;
+                    res.mean_score = history[k].mean_score;
+                    gen_results.push_back(res);
+                }
+                if (sink) sink->OnGeneration(gen, gen_results);
+                else evolution_history.push_back(gen_results);
+            }
+            current_population = state.population;
+            istringstream(state.rng) >> evo_rng;
+            first_generation = state.generation;
+            stopped = state.stopped;
+        }
+        checkpoint = make_unique<CheckpointWriter>(config.checkpoint, key, history.size());
+    }
+    auto save = [&](int next_generation) {
+        EvolutionState state;
+        state.generation = next_generation;
+        state.stopped = stopped;
+        state.population = current_population;
+        ostringstream rng_state;
+        rng_state << evo_rng;
+        state.rng = rng_state.str();
+        checkpoint->Save(state, move(unsaved));
+        unsaved.clear();
+    };
+
+    vector<double> payoff(n * n, 0.0), fitness(n, 0.0);
+    for (int gen = first_generation; gen < config.generations && !stopped; ++gen) {
+        EvaluatePairs(current_population, gen, payoff);
+
+        vector<StrategyResult> gen_results;
+        double total_fitness = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (current_population[i] == 0) continue;
+            double score = payoff[i * n + i];
+            for (size_t j = 0; j < n; ++j) {
+                if (j != i && current_population[j] > 0) score += payoff[i * n + j] * current_population[j];
+            }
+            fitness[i] = score - scb_cost[i];
+
+            StrategyResult res;
+            res.name = names[i];
+            res.strategy = i;
+            res.population = current_population[i];
+            res.mean_score = fitness[i];
+            total_fitness += res.mean_score * res.population;
+            gen_results.push_back(res);
+            if (checkpoint) unsaved.push_back({ gen, static_cast<uint32_t>(i), res.population, 0, res.mean_score });
+        }
+        if (sink) sink->OnGeneration(gen, gen_results);
+        else evolution_history.push_back(gen_results);
+
+        if (total_fitness <= 0) {
+            stopped = true;
+            if (checkpoint) save(gen + 1);
+            break;
+        }
+
+        vector<int> next_population;
+        if (config.selection == "wright-fisher") {
+            next_population = SelectWrightFisher(current_population, fitness, config.population, evo_rng);
+        }
+        else if (config.selection == "moran") {
+            next_population = SelectMoran(current_population, fitness, payoff, config.population, evo_rng);
+        }
+        else {
+            next_population = SelectProportional(current_population, fitness, total_fitness, config.population, evo_rng);
+        }
+        Mutate(next_population, config.mutation, evo_rng);
+        current_population = next_population;
+
+        if (checkpoint && ((gen + 1) % config.checkpoint_every == 0 || gen + 1 == config.generations)) save(gen + 1);
+    }
+    if (checkpoint) checkpoint->Flush();
+    if (sink) sink->End();
+    return evolution_history;
+}
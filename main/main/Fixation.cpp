@@ -0,0 +1,189 @@
+#include "Engine.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Instrument.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Fixation probabilities (--fixation). Payoffs come from a table of mean match
+// scores per round, a[i][j] for i against j, played once up front over
+// config.repeats matches per pairing. In a population of N with k mutants A and
+// N - k residents B, each meets everyone else once:
+//   pi_A(k) = ((k - 1) a_AA + (N - k) a_AB) / (N - 1)
+//   pi_B(k) = (k a_BA + (N - k - 1) a_BB) / (N - 1)
+// and fitness is exp(w pi). A birth-death step changes k only when the parent and
+// the dying individual differ, so a trial is the embedded walk that goes up with
+// probability f_A / (f_A + f_B), started at k = 1 and run until 0 or N.
+//
+// Trials run in chunks, each chunk on its own stream seeded from (seed, chunk,
+// resident, mutant), so the estimates do not depend on the thread count. Every
+// pairing starts with a pilot of kPilotChunks; from its 95% Wilson interval the
+// trials needed for a half-width of config.fixation_ci are planned with the
+// largest variance inside the interval (capped at config.fixation_trials) and
+// run in a second pass, which alone gives the estimate. Stopping once the
+// running interval is narrow enough, or counting the pilot in, would favour
+// runs that happen to look rare and bias the estimates low.
+
+namespace {
+
+const uint64_t kFixationStream = 0x46495841ULL;
+const uint64_t kFixationChunk = 1024;
+const uint64_t kPilotChunks = 4;
+
+// 95% Wilson score interval for fixations out of trials.
+pair<double, double> WilsonInterval(uint64_t fixations, uint64_t trials) {
+    const double z = 1.96;
+    double n = static_cast<double>(trials), p = fixations / n;
+    double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+    double half = z / (1 + z * z / n) * sqrt(p * (1 - p) / n + z * z / (4 * n * n));
+    return { max(0.0, center - half), min(1.0, center + half) };
+}
+
+struct FixationPair {
+    size_t resident = 0, mutant = 0;
+    vector<uint64_t> up;   // up[k]: the walk moves k -> k + 1 when a draw is below it
+    double exact = 0.0;
+    uint64_t pilot_fixations = 0;
+    uint64_t trials = 0, fixations = 0;
+};
+
+}
+
+vector<FixationResult> Engine::RunFixation(ResultSink* sink) {
+    const size_t n = strategy_pool.size();
+    const int N = config.population;
+    if (N < 2) throw runtime_error("Fixation needs a population of at least 2");
+    if (config.fixation_ci <= 0.0) throw runtime_error("--fixation-ci must be positive");
+    if (config.fixation_trials < kFixationChunk) throw runtime_error("--fixation-trials must be at least " + to_string(kFixationChunk));
+
+    vector<double> scb_cost(n, 0.0);
+    if (config.apply_scb) {
+        for (size_t i = 0; i < n; ++i) scb_cost[i] = GetSCB_Cost(names[i]);
+    }
+
+    // Payoff per round of i against j, averaged over the repeats in rep order.
+    vector<double> a(n * n, 0.0);
+    vector<pair<size_t, size_t>> pairings;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) pairings.emplace_back(i, j);
+    }
+    auto evaluate = [&](size_t begin, size_t end) {
+        PhaseScope phase(Phase::Evaluate);
+        auto& players = SlotPlayers();
+        for (size_t p = begin; p < end; ++p) {
+            size_t i = pairings[p].first, j = pairings[p].second;
+            double si = 0.0, sj = 0.0;
+            for (int rep = 0; rep < config.repeats; ++rep) {
+                PairTimer timer(i, j, config.rounds);
+                auto scores = PlayPair(players, i, j, MatchSeed(config.seed ^ kFixationStream, rep, i, j));
+                si += scores.first;
+                sj += scores.second;
+            }
+            double scale = 1.0 / (static_cast<double>(config.repeats) * config.rounds);
+            if (i == j) {
+                a[i * n + i] = (0.5 * (si + sj) / config.repeats - scb_cost[i]) / config.rounds;
+            }
+            else {
+                a[i * n + j] = si * scale - scb_cost[i] / config.rounds;
+                a[j * n + i] = sj * scale - scb_cost[j] / config.rounds;
+            }
+        }
+    };
+    if (pool) pool->ParallelFor(pairings.size(), 1, evaluate);
+    else evaluate(0, pairings.size());
+
+    // Walk probabilities per ordered pair, and the closed form
+    // rho = 1 / sum_{j=0}^{N-1} prod_{k=1}^{j} f_B(k) / f_A(k), summed in logs.
+    const double w = config.selection_strength;
+    vector<FixationPair> pairs;
+    for (size_t b = 0; b < n; ++b) {
+        for (size_t m = 0; m < n; ++m) {
+            if (b == m) continue;
+            FixationPair entry;
+            entry.resident = b;
+            entry.mutant = m;
+            entry.up.assign(N, 0);
+            double aa = a[m * n + m], ab = a[m * n + b], ba = a[b * n + m], bb = a[b * n + b];
+            vector<double> log_terms(1, 0.0);
+            for (int k = 1; k < N; ++k) {
+                double pi_a = ((k - 1) * aa + (N - k) * ab) / (N - 1);
+                double pi_b = (k * ba + (N - k - 1) * bb) / (N - 1);
+                double p_up = 1.0 / (1.0 + exp(w * (pi_b - pi_a)));
+                entry.up[k] = p_up >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(ldexp(p_up, 64));
+                log_terms.push_back(log_terms.back() + w * (pi_b - pi_a));
+            }
+            double top = *max_element(log_terms.begin(), log_terms.end()), sum = 0.0;
+            for (double t : log_terms) sum += exp(t - top);
+            entry.exact = exp(-top) / sum;
+            pairs.push_back(move(entry));
+        }
+    }
+
+    // (pair, chunk) tasks of a pass, and the fixations each produced. Pilot
+    // chunks come first in the chunk numbering, so the passes never share a stream.
+    vector<pair<size_t, uint64_t>> tasks;
+    vector<uint64_t> task_fixations;
+    auto run = [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const FixationPair& entry = pairs[tasks[t].first];
+            Rng gen;
+            gen.Seed(MatchSeed(config.seed ^ kFixationStream, tasks[t].second, entry.resident, entry.mutant));
+            const uint64_t* up = entry.up.data();
+            uint64_t fixed = 0;
+            for (uint64_t trial = 0; trial < kFixationChunk; ++trial) {
+                int k = 1;
+                while (k > 0 && k < N) k += gen() < up[k] ? 1 : -1;
+                fixed += k == N;
+            }
+            task_fixations[t] = fixed;
+        }
+    };
+    auto run_pass = [&] {
+        task_fixations.assign(tasks.size(), 0);
+        if (pool) pool->ParallelFor(tasks.size(), 1, run);
+        else run(0, tasks.size());
+    };
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        for (uint64_t c = 0; c < kPilotChunks; ++c) tasks.emplace_back(p, c);
+    }
+    run_pass();
+    for (size_t t = 0; t < tasks.size(); ++t) pairs[tasks[t].first].pilot_fixations += task_fixations[t];
+
+    const uint64_t max_chunks = config.fixation_trials / kFixationChunk;
+    tasks.clear();
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        auto& entry = pairs[p];
+        auto ci = WilsonInterval(entry.pilot_fixations, kPilotChunks * kFixationChunk);
+        double variance = ci.first <= 0.5 && ci.second >= 0.5 ? 0.25 : max(ci.first * (1 - ci.first), ci.second * (1 - ci.second));
+        double trials = 1.96 * 1.96 * variance / (config.fixation_ci * config.fixation_ci);
+        auto planned = static_cast<uint64_t>(clamp(ceil(trials / kFixationChunk), 1.0, static_cast<double>(max_chunks)));
+        for (uint64_t c = 0; c < planned; ++c) tasks.emplace_back(p, kPilotChunks + c);
+    }
+    run_pass();
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        auto& entry = pairs[tasks[t].first];
+        entry.fixations += task_fixations[t];
+        entry.trials += kFixationChunk;
+    }
+
+    vector<FixationResult> results;
+    for (const auto& entry : pairs) {
+        FixationResult res;
+        res.resident = entry.resident;
+        res.mutant = entry.mutant;
+        res.trials = entry.trials;
+        res.fixations = entry.fixations;
+        res.probability = static_cast<double>(entry.fixations) / entry.trials;
+        tie(res.ci_lower, res.ci_upper) = WilsonInterval(entry.fixations, entry.trials);
+        res.exact = entry.exact;
+        results.push_back(res);
+    }
+    if (sink) {
+        sink->Begin(names);
+        sink->OnFixation(N, results);
+        sink->End();
+    }
+    return results;
+}
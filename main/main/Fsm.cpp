@@ -0,0 +1,431 @@
+#include "Fsm.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Builds a table from output[] and a rule next(state, my_move, opp_move).
+template<typename Rule>
+FsmStrategy MakeFsm(const string& name, int32_t initial, vector<int32_t> output, Rule next) {
+    FsmStrategy fsm;
+    fsm.name = name;
+    fsm.initial = initial;
+    fsm.output = move(output);
+    fsm.transition.resize(fsm.States() * 4);
+    for (int32_t s = 0; s < static_cast<int32_t>(fsm.States()); ++s) {
+        for (int32_t o = 0; o < 4; ++o) fsm.transition[s * 4 + o] = next(s, o >> 1, o & 1);
+    }
+    return fsm;
+}
+
+}
+
+optional<FsmStrategy> BuiltinFsm(const string& name) {
+    string upper_name = name;
+    transform(upper_name.begin(), upper_name.end(), upper_name.begin(), ::toupper);
+
+    if (upper_name == "ALLC") return MakeFsm("ALLC", 0, { 0 }, [](int32_t, int32_t, int32_t) { return 0; });
+    if (upper_name == "ALLD") return MakeFsm("ALLD", 0, { 1 }, [](int32_t, int32_t, int32_t) { return 0; });
+    // State = the move to play next.
+    if (upper_name == "TFT") return MakeFsm("TFT", 0, { 0, 1 }, [](int32_t, int32_t, int32_t opp) { return opp; });
+    if (upper_name == "SUS_TFT") return MakeFsm("SUS_TFT", 1, { 0, 1 }, [](int32_t, int32_t, int32_t opp) { return opp; });
+    if (upper_name == "GRIM") return MakeFsm("GRIM", 0, { 0, 1 }, [](int32_t s, int32_t, int32_t opp) { return s | opp; });
+    if (upper_name == "PAVLOV") return MakeFsm("PAVLOV", 0, { 0, 1 }, [](int32_t, int32_t mine, int32_t opp) { return mine ^ opp; });
+    if (upper_name == "ALTERNATE") return MakeFsm("ALTERNATE", 0, { 0, 1 }, [](int32_t s, int32_t, int32_t) { return s ^ 1; });
+
+    // 0 = first round; 1 + b*2 + c = second round; 5 + a*4 + b*2 + c later on,
+    // where a/b are my moves two/one rounds ago and c the opponent's last move.
+    if (upper_name == "CONTRITE") {
+        vector<int32_t> output(13, 0);
+        for (int32_t b = 0; b < 2; ++b) {
+            for (int32_t c = 0; c < 2; ++c) {
+                output[1 + b * 2 + c] = c;
+                for (int32_t a = 0; a < 2; ++a) output[5 + a * 4 + b * 2 + c] = (a == 0 && b == 1 && c == 1) ? 0 : c;
+            }
+        }
+        return MakeFsm("CONTRITE", 0, output, [](int32_t s, int32_t mine, int32_t opp) {
+            if (s == 0) return 1 + mine * 2 + opp;
+            int32_t last_mine = s < 5 ? (s - 1) >> 1 : ((s - 5) >> 1) & 1;
+            return 5 + last_mine * 4 + mine * 2 + opp;
+            });
+    }
+
+    // Probe C, D, C, C; if the opponent cooperated in rounds 2-4 exploit it
+    // forever, otherwise play TFT. 2/4 = probe still clean, 3/5 = opponent defected.
+    if (upper_name == "PROBER") {
+        enum { R0, R1, R2_OK, R2_BAD, R3_OK, R3_BAD, EXPLOIT, TFT_C, TFT_D };
+        return MakeFsm("PROBER", R0, { 0, 1, 0, 0, 0, 0, 1, 0, 1 }, [](int32_t s, int32_t, int32_t opp) -> int32_t {
+            switch (s) {
+            case R0: return R1;
+            case R1: return opp ? R2_BAD : R2_OK;
+            case R2_OK: return opp ? R3_BAD : R3_OK;
+            case R2_BAD: return R3_BAD;
+            case R3_OK: return opp ? TFT_D : EXPLOIT;
+            case EXPLOIT: return EXPLOIT;
+            default: return opp ? TFT_D : TFT_C;
+            }
+            });
+    }
+    return nullopt;
+}
+
+namespace {
+
+// Per-lane state, structure-of-arrays so a SIMD register covers consecutive lanes.
+// Noise comes from one xoshiro128++ generator per lane.
+struct Lanes {
+    vector<int32_t> s1, s2, d1, d2, dd;
+    vector<uint32_t> r0, r1, r2, r3;
+
+    explicit Lanes(size_t n) : s1(n), s2(n), d1(n), d2(n), dd(n), r0(n), r1(n), r2(n), r3(n) {}
+};
+
+struct Tables {
+    const int32_t* out1;
+    const int32_t* out2;
+    const int32_t* next1;
+    const int32_t* next2;
+};
+
+inline uint32_t Rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+inline uint32_t NextRandom(Lanes& L, size_t k) {
+    uint32_t result = Rotl(L.r0[k] + L.r3[k], 7) + L.r0[k];
+    uint32_t t = L.r1[k] << 9;
+    L.r2[k] ^= L.r0[k];
+    L.r3[k] ^= L.r1[k];
+    L.r1[k] ^= L.r2[k];
+    L.r0[k] ^= L.r3[k];
+    L.r2[k] ^= t;
+    L.r3[k] = Rotl(L.r3[k], 11);
+    return result;
+}
+
+void RunScalar(const Tables& t, Lanes& L, size_t begin, size_t end, int rounds, bool noisy, uint32_t threshold) {
+    for (size_t k = begin; k < end; ++k) {
+        int32_t s1 = L.s1[k], s2 = L.s2[k], d1 = 0, d2 = 0, dd = 0;
+        for (int r = 0; r < rounds; ++r) {
+            int32_t m1 = t.out1[s1], m2 = t.out2[s2];
+            if (noisy) {
+                m1 ^= NextRandom(L, k) < threshold;
+                m2 ^= NextRandom(L, k) < threshold;
+            }
+            d1 += m1; d2 += m2; dd += m1 & m2;
+            s1 = t.next1[s1 * 4 + m1 * 2 + m2];
+            s2 = t.next2[s2 * 4 + m2 * 2 + m1];
+        }
+        L.s1[k] = s1; L.s2[k] = s2; L.d1[k] = d1; L.d2[k] = d2; L.dd[k] = dd;
+    }
+}
+
+#if defined(__AVX2__)
+template<int K>
+inline __m256i Rotl8(__m256i x) { return _mm256_or_si256(_mm256_slli_epi32(x, K), _mm256_srli_epi32(x, 32 - K)); }
+
+size_t RunAvx2(const Tables& t, Lanes& L, size_t begin, size_t end, int rounds, bool noisy, uint32_t threshold) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    const __m256i thr = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(threshold)), sign);
+    size_t k = begin;
+    for (; k + 8 <= end; k += 8) {
+        auto load = [&](auto& v) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&v[k])); };
+        auto store = [&](auto& v, __m256i x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(&v[k]), x); };
+        __m256i s1 = load(L.s1), s2 = load(L.s2);
+        __m256i r0 = load(L.r0), r1 = load(L.r1), r2 = load(L.r2), r3 = load(L.r3);
+        __m256i d1 = _mm256_setzero_si256(), d2 = d1, dd = d1;
+
+        auto flip = [&]() {
+            __m256i result = _mm256_add_epi32(Rotl8<7>(_mm256_add_epi32(r0, r3)), r0);
+            __m256i tt = _mm256_slli_epi32(r1, 9);
+            r2 = _mm256_xor_si256(r2, r0);
+            r3 = _mm256_xor_si256(r3, r1);
+            r1 = _mm256_xor_si256(r1, r2);
+            r0 = _mm256_xor_si256(r0, r3);
+            r2 = _mm256_xor_si256(r2, tt);
+            r3 = Rotl8<11>(r3);
+            // Unsigned result < threshold, via the sign-flip trick.
+            return _mm256_and_si256(_mm256_cmpgt_epi32(thr, _mm256_xor_si256(result, sign)), one);
+        };
+
+        for (int r = 0; r < rounds; ++r) {
+            __m256i m1 = _mm256_i32gather_epi32(t.out1, s1, 4);
+            __m256i m2 = _mm256_i32gather_epi32(t.out2, s2, 4);
+            if (noisy) {
+                m1 = _mm256_xor_si256(m1, flip());
+                m2 = _mm256_xor_si256(m2, flip());
+            }
+            d1 = _mm256_add_epi32(d1, m1);
+            d2 = _mm256_add_epi32(d2, m2);
+            dd = _mm256_add_epi32(dd, _mm256_and_si256(m1, m2));
+            __m256i i1 = _mm256_add_epi32(_mm256_slli_epi32(s1, 2), _mm256_add_epi32(_mm256_slli_epi32(m1, 1), m2));
+            __m256i i2 = _mm256_add_epi32(_mm256_slli_epi32(s2, 2), _mm256_add_epi32(_mm256_slli_epi32(m2, 1), m1));
+            s1 = _mm256_i32gather_epi32(t.next1, i1, 4);
+            s2 = _mm256_i32gather_epi32(t.next2, i2, 4);
+        }
+        store(L.s1, s1); store(L.s2, s2); store(L.d1, d1); store(L.d2, d2); store(L.dd, dd);
+        store(L.r0, r0); store(L.r1, r1); store(L.r2, r2); store(L.r3, r3);
+    }
+    return k;
+}
+#endif
+
+#if defined(__AVX512F__)
+template<int K>
+inline __m512i Rotl16(__m512i x) { return _mm512_or_si512(_mm512_slli_epi32(x, K), _mm512_srli_epi32(x, 32 - K)); }
+
+size_t RunAvx512(const Tables& t, Lanes& L, size_t begin, size_t end, int rounds, bool noisy, uint32_t threshold) {
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i thr = _mm512_set1_epi32(static_cast<int32_t>(threshold));
+    size_t k = begin;
+    for (; k + 16 <= end; k += 16) {
+        auto load = [&](auto& v) { return _mm512_loadu_si512(&v[k]); };
+        auto store = [&](auto& v, __m512i x) { _mm512_storeu_si512(&v[k], x); };
+        __m512i s1 = load(L.s1), s2 = load(L.s2);
+        __m512i r0 = load(L.r0), r1 = load(L.r1), r2 = load(L.r2), r3 = load(L.r3);
+        __m512i d1 = _mm512_setzero_si512(), d2 = d1, dd = d1;
+
+        auto flip = [&]() {
+            __m512i result = _mm512_add_epi32(Rotl16<7>(_mm512_add_epi32(r0, r3)), r0);
+            __m512i tt = _mm512_slli_epi32(r1, 9);
+            r2 = _mm512_xor_si512(r2, r0);
+            r3 = _mm512_xor_si512(r3, r1);
+            r1 = _mm512_xor_si512(r1, r2);
+            r0 = _mm512_xor_si512(r0, r3);
+            r2 = _mm512_xor_si512(r2, tt);
+            r3 = Rotl16<11>(r3);
+            return _mm512_maskz_mov_epi32(_mm512_cmplt_epu32_mask(result, thr), one);
+        };
+
+        // Masked gathers with an explicit source avoid GCC's uninitialized-operand warning.
+        const __m512i zero = _mm512_setzero_si512();
+        auto gather = [&](__m512i idx, const int32_t* base) { return _mm512_mask_i32gather_epi32(zero, 0xFFFF, idx, base, 4); };
+
+        for (int r = 0; r < rounds; ++r) {
+            __m512i m1 = gather(s1, t.out1);
+            __m512i m2 = gather(s2, t.out2);
+            if (noisy) {
+                m1 = _mm512_xor_si512(m1, flip());
+                m2 = _mm512_xor_si512(m2, flip());
+            }
+            d1 = _mm512_add_epi32(d1, m1);
+            d2 = _mm512_add_epi32(d2, m2);
+            dd = _mm512_add_epi32(dd, _mm512_and_si512(m1, m2));
+            __m512i i1 = _mm512_add_epi32(_mm512_slli_epi32(s1, 2), _mm512_add_epi32(_mm512_slli_epi32(m1, 1), m2));
+            __m512i i2 = _mm512_add_epi32(_mm512_slli_epi32(s2, 2), _mm512_add_epi32(_mm512_slli_epi32(m2, 1), m1));
+            s1 = gather(i1, t.next1);
+            s2 = gather(i2, t.next2);
+        }
+        store(L.s1, s1); store(L.s2, s2); store(L.d1, d1); store(L.d2, d2); store(L.dd, dd);
+        store(L.r0, r0); store(L.r1, r1); store(L.r2, r2); store(L.r3, r3);
+    }
+    return k;
+}
+#endif
+
+uint64_t SplitMix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+}
+
+void CountFsmBatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const uint64_t* lane_seeds, size_t lanes, OutcomeCounts* out) {
+    Lanes L(lanes);
+    for (size_t k = 0; k < lanes; ++k) {
+        L.s1[k] = a.initial;
+        L.s2[k] = b.initial;
+        uint64_t x = lane_seeds[k];
+        uint64_t lo = SplitMix64(x), hi = SplitMix64(x);
+        L.r0[k] = static_cast<uint32_t>(lo);
+        L.r1[k] = static_cast<uint32_t>(lo >> 32);
+        L.r2[k] = static_cast<uint32_t>(hi);
+        L.r3[k] = static_cast<uint32_t>(hi >> 32) | 1; // never the all-zero state
+    }
+
+    Tables t{ a.output.data(), b.output.data(), a.transition.data(), b.transition.data() };
+    bool noisy = epsilon > 0.0;
+    double scaled = epsilon * 4294967296.0;
+    uint32_t threshold = scaled >= 4294967295.0 ? 0xFFFFFFFFu : static_cast<uint32_t>(scaled);
+
+    size_t done = 0;
+#if defined(__AVX512F__)
+    done = RunAvx512(t, L, done, lanes, rounds, noisy, threshold);
+#endif
+#if defined(__AVX2__)
+    done = RunAvx2(t, L, done, lanes, rounds, noisy, threshold);
+#endif
+    RunScalar(t, L, done, lanes, rounds, noisy, threshold);
+
+    for (size_t k = 0; k < lanes; ++k) {
+        double dd = L.dd[k], dc = L.d1[k] - dd, cd = L.d2[k] - dd;
+        out[k] = { rounds - dd - dc - cd, cd, dc, dd };
+    }
+}
+
+void RunFsmBatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const PayoffMatrix<double>& payoffs, const uint64_t* lane_seeds, size_t lanes,
+    pair<double, double>* out) {
+    vector<OutcomeCounts> counts(lanes);
+    CountFsmBatch(a, b, rounds, epsilon, lane_seeds, lanes, counts.data());
+    for (size_t k = 0; k < lanes; ++k) out[k] = counts[k].Score(payoffs);
+}
+
+namespace {
+
+OutcomeCounts& operator+=(OutcomeCounts& x, const OutcomeCounts& y) {
+    x.cc += y.cc; x.cd += y.cd; x.dc += y.dc; x.dd += y.dd;
+    return x;
+}
+
+OutcomeCounts Scaled(const OutcomeCounts& x, double k) {
+    return { x.cc * k, x.cd * k, x.dc * k, x.dd * k };
+}
+
+OutcomeCounts ExactDeterministic(const FsmStrategy& a, const FsmStrategy& b, int rounds) {
+    // first_seen[joint] = round the joint state was first entered; prefix[t] = counts after t rounds.
+    vector<int> first_seen(a.States() * b.States(), -1);
+    vector<OutcomeCounts> prefix{ OutcomeCounts{} };
+    int32_t s1 = a.initial, s2 = b.initial;
+
+    for (int t = 0; t < rounds; ++t) {
+        size_t joint = s1 * b.States() + s2;
+        if (first_seen[joint] >= 0) {
+            int start = first_seen[joint];
+            int length = t - start;
+            long long cycles = (rounds - t) / length;
+            int rest = (rounds - t) % length;
+            auto total = prefix[t];
+            total += Scaled(prefix[t], static_cast<double>(cycles));
+            total += Scaled(prefix[start], -static_cast<double>(cycles));
+            total += prefix[start + rest];
+            total += Scaled(prefix[start], -1.0);
+            return total;
+        }
+        first_seen[joint] = t;
+
+        Move m1 = a.Output(s1), m2 = b.Output(s2);
+        OutcomeCounts step = prefix[t];
+        if (m1 == Move::C) (m2 == Move::C ? step.cc : step.cd) += 1.0;
+        else (m2 == Move::C ? step.dc : step.dd) += 1.0;
+        prefix.push_back(step);
+        s1 = a.Next(s1, m1, m2);
+        s2 = b.Next(s2, m2, m1);
+    }
+    return prefix.back();
+}
+
+OutcomeCounts ExactNoisy(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon) {
+    // Joint states reachable from the start under any noise outcome.
+    map<pair<int32_t, int32_t>, size_t> index;
+    vector<pair<int32_t, int32_t>> states{ { a.initial, b.initial } };
+    index[states[0]] = 0;
+    for (size_t k = 0; k < states.size(); ++k) {
+        for (int o = 0; o < 4; ++o) {
+            Move m1 = (o >> 1) ? Move::D : Move::C, m2 = (o & 1) ? Move::D : Move::C;
+            pair<int32_t, int32_t> next{ a.Next(states[k].first, m1, m2), b.Next(states[k].second, m2, m1) };
+            if (index.emplace(next, states.size()).second) states.push_back(next);
+        }
+    }
+
+    // Sparse chain: from each state four (probability, successor) edges, one per
+    // joint outcome o = (m1 == D) * 2 + (m2 == D), whose probability is also the
+    // expected count of o contributed by a round spent in that state.
+    size_t n = states.size();
+    vector<double> edge_p(n * 4);
+    vector<size_t> edge_to(n * 4);
+    vector<vector<double>> reward(4, vector<double>(n));
+    for (size_t k = 0; k < n; ++k) {
+        Move want1 = a.Output(states[k].first), want2 = b.Output(states[k].second);
+        for (int o = 0; o < 4; ++o) {
+            Move m1 = (o >> 1) ? Move::D : Move::C, m2 = (o & 1) ? Move::D : Move::C;
+            double p = (m1 == want1 ? 1.0 - epsilon : epsilon) * (m2 == want2 ? 1.0 - epsilon : epsilon);
+            reward[o][k] = p;
+            edge_p[k * 4 + o] = p;
+            edge_to[k * 4 + o] = index[{ a.Next(states[k].first, m1, m2), b.Next(states[k].second, m2, m1) }];
+        }
+    }
+    double total[4] = {};
+
+    // Short matches: push the distribution forward round by round.
+    if (static_cast<double>(rounds) * n <= 4.0 * n * n * n) {
+        vector<double> dist(n, 0.0), next(n);
+        dist[0] = 1.0;
+        for (int t = 0; t < rounds; ++t) {
+            fill(next.begin(), next.end(), 0.0);
+            for (size_t k = 0; k < n; ++k) {
+                if (dist[k] == 0.0) continue;
+                for (int o = 0; o < 4; ++o) {
+                    total[o] += dist[k] * reward[o][k];
+                    next[edge_to[k * 4 + o]] += dist[k] * edge_p[k * 4 + o];
+                }
+            }
+            dist.swap(next);
+        }
+        return { total[0], total[1], total[2], total[3] };
+    }
+
+    // Long matches: binary powering of (M^k, w_k = sum_{t<k} M^t r), using
+    // w_{2k} = w_k + M^k w_k and w_{k+1} = w_k + M^k r.
+    using Matrix = vector<double>;
+    auto multiply = [n](const Matrix& x, const Matrix& y) {
+        Matrix z(n * n, 0.0);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t k = 0; k < n; ++k) {
+                double xik = x[i * n + k];
+                if (xik == 0.0) continue;
+                for (size_t j = 0; j < n; ++j) z[i * n + j] += xik * y[k * n + j];
+            }
+        return z;
+    };
+    auto apply = [n](const Matrix& x, const vector<double>& v) {
+        vector<double> out(n, 0.0);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < n; ++j) out[i] += x[i * n + j] * v[j];
+        return out;
+    };
+
+    Matrix step(n * n, 0.0), power(n * n, 0.0);
+    for (size_t k = 0; k < n; ++k) {
+        power[k * n + k] = 1.0;
+        for (int o = 0; o < 4; ++o) step[k * n + edge_to[k * 4 + o]] += edge_p[k * 4 + o];
+    }
+    vector<vector<double>> w(4, vector<double>(n, 0.0));
+    int high = 31;
+    while (high > 0 && !((rounds >> high) & 1)) --high;
+    for (int bit = high; bit >= 0; --bit) {
+        for (auto& wo : w) {
+            auto pw = apply(power, wo);
+            for (size_t k = 0; k < n; ++k) wo[k] += pw[k];
+        }
+        power = multiply(power, power);
+        if ((rounds >> bit) & 1) {
+            for (int o = 0; o < 4; ++o) {
+                auto r = apply(power, reward[o]);
+                for (size_t k = 0; k < n; ++k) w[o][k] += r[k];
+            }
+            power = multiply(power, step);
+        }
+    }
+    return { w[0][0], w[1][0], w[2][0], w[3][0] };
+}
+
+}
+
+OutcomeCounts ExactFsmCounts(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon) {
+    if (epsilon == 0.0) return ExactDeterministic(a, b, rounds);
+    return ExactNoisy(a, b, rounds, epsilon);
+}
+
+pair<double, double> ExactFsmMatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const PayoffMatrix<double>& payoffs) {
+    return ExactFsmCounts(a, b, rounds, epsilon).Score(payoffs);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Strategy.h"
+#include <cstdint>
+#include <optional>
+
+// Finite-state-machine form of a deterministic strategy. The state fixes the next
+// move; after each round the machine steps on the outcome it observed, indexed
+// from its own side as my_move * 2 + opp_move (C = 0, D = 1).
+struct FsmStrategy {
+    std::string name;
+    int32_t initial = 0;
+    std::vector<int32_t> output;     // move per state, 0 = C, 1 = D
+    std::vector<int32_t> transition; // next state, index state * 4 + outcome
+
+    size_t States() const { return output.size(); }
+    Move Output(int32_t s) const { return output[s] ? Move::D : Move::C; }
+    int32_t Next(int32_t s, Move mine, Move opp) const {
+        return transition[s * 4 + (mine == Move::D) * 2 + (opp == Move::D)];
+    }
+};
+
+// Table form of a built-in strategy, or nullopt if it has none (RND).
+std::optional<FsmStrategy> BuiltinFsm(const std::string& name);
+
+// Plays an FsmStrategy through the regular Strategy interface.
+class FsmPlayer final : public Strategy {
+private:
+    FsmStrategy fsm;
+    int32_t state = 0;
+
+public:
+    explicit FsmPlayer(FsmStrategy table) : fsm(std::move(table)), state(fsm.initial) {}
+    void reset() override { state = fsm.initial; }
+    Move decide(const History& self_history, const History& opp_history) override {
+        if (!self_history.empty()) state = fsm.Next(state, self_history.back(), opp_history.back());
+        return fsm.Output(state);
+    }
+    string name() const override { return fsm.name; }
+    bool is_deterministic() const override { return true; }
+};
+
+// Outcome counts of `lanes` independent matches of a against b, one per SIMD lane
+// (AVX-512 or AVX2 when compiled in, scalar otherwise). Lane k draws its noise
+// from its own generator seeded by lane_seeds[k], so the results do not depend
+// on the instruction set used.
+void CountFsmBatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const uint64_t* lane_seeds, size_t lanes, OutcomeCounts* out);
+
+// CountFsmBatch scored under payoffs: both players' scores for each lane go to out.
+void RunFsmBatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const PayoffMatrix<double>& payoffs, const uint64_t* lane_seeds, size_t lanes,
+    std::pair<double, double>* out);
+
+// Exact outcome counts (and scores) of a rounds-long match between two tables, no
+// sampling involved. Without noise the joint state (a's state, b's state) is walked
+// until it repeats, and the remaining rounds are summed in closed form from the
+// cycle. With noise the result is the expectation under the joint-state Markov chain.
+OutcomeCounts ExactFsmCounts(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon);
+std::pair<double, double> ExactFsmMatch(const FsmStrategy& a, const FsmStrategy& b, int rounds, double epsilon,
+    const PayoffMatrix<double>& payoffs);
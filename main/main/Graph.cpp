@@ -0,0 +1,128 @@
+#include "Graph.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+Graph BuildGraph(size_t nodes, vector<pair<uint32_t, uint32_t>> edges) {
+    if (nodes > numeric_limits<uint32_t>::max()) throw runtime_error("Graph has too many nodes");
+    for (auto& e : edges) {
+        if (e.first >= nodes || e.second >= nodes) throw runtime_error("Graph edge refers to a missing node");
+        if (e.first > e.second) swap(e.first, e.second);
+    }
+    edges.erase(remove_if(edges.begin(), edges.end(), [](const auto& e) { return e.first == e.second; }), edges.end());
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    Graph g;
+    g.offsets.assign(nodes + 1, 0);
+    for (const auto& e : edges) {
+        g.offsets[e.first + 1]++;
+        g.offsets[e.second + 1]++;
+    }
+    for (size_t u = 0; u < nodes; ++u) g.offsets[u + 1] += g.offsets[u];
+
+    g.neighbours.resize(g.offsets[nodes]);
+    vector<uint64_t> fill(g.offsets.begin(), g.offsets.end() - 1);
+    for (const auto& e : edges) {
+        g.neighbours[fill[e.first]++] = e.second;
+        g.neighbours[fill[e.second]++] = e.first;
+    }
+    for (size_t u = 0; u < nodes; ++u) {
+        sort(g.neighbours.begin() + g.offsets[u], g.neighbours.begin() + g.offsets[u + 1]);
+    }
+
+    g.reverse.resize(g.neighbours.size());
+    for (size_t u = 0; u < nodes; ++u) {
+        for (uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e) {
+            uint32_t v = g.neighbours[e];
+            auto row_begin = g.neighbours.begin() + g.offsets[v], row_end = g.neighbours.begin() + g.offsets[v + 1];
+            g.reverse[e] = static_cast<uint64_t>(lower_bound(row_begin, row_end, static_cast<uint32_t>(u)) - g.neighbours.begin());
+        }
+    }
+    return g;
+}
+
+Graph LatticeGraph(uint32_t width, uint32_t height, bool moore) {
+    if (width == 0 || height == 0) throw runtime_error("Lattice dimensions must be positive");
+    size_t nodes = static_cast<size_t>(width) * height;
+    vector<pair<uint32_t, uint32_t>> edges;
+    edges.reserve(nodes * (moore ? 4 : 2));
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t u = y * width + x;
+            uint32_t right = y * width + (x + 1) % width;
+            uint32_t down = ((y + 1) % height) * width + x;
+            edges.emplace_back(u, right);
+            edges.emplace_back(u, down);
+            if (moore) {
+                edges.emplace_back(u, ((y + 1) % height) * width + (x + 1) % width);
+                edges.emplace_back(u, ((y + 1) % height) * width + (x + width - 1) % width);
+            }
+        }
+    }
+    return BuildGraph(nodes, move(edges));
+}
+
+Graph LoadEdgeList(const string& path) {
+    ifstream in(path);
+    if (!in) throw runtime_error("Cannot open graph file: " + path);
+
+    vector<pair<uint64_t, uint64_t>> raw;
+    string line;
+    while (getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#' || line[start] == '%') continue;
+        const char* p = line.c_str() + start;
+        char* end = nullptr;
+        uint64_t u = strtoull(p, &end, 10);
+        if (end == p) throw runtime_error("Malformed graph line: " + line);
+        p = end;
+        uint64_t v = strtoull(p, &end, 10);
+        if (end == p) throw runtime_error("Malformed graph line: " + line);
+        raw.emplace_back(u, v);
+    }
+
+    // Dense ids follow the order of the raw ids.
+    vector<uint64_t> ids;
+    ids.reserve(raw.size() * 2);
+    for (const auto& e : raw) {
+        ids.push_back(e.first);
+        ids.push_back(e.second);
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    auto dense = [&](uint64_t id) { return static_cast<uint32_t>(lower_bound(ids.begin(), ids.end(), id) - ids.begin()); };
+
+    vector<pair<uint32_t, uint32_t>> edges;
+    edges.reserve(raw.size());
+    for (const auto& e : raw) edges.emplace_back(dense(e.first), dense(e.second));
+    raw.clear();
+    raw.shrink_to_fit();
+    Graph g = BuildGraph(ids.size(), edges);
+
+    // Breadth-first relabelling, one component after another.
+    vector<uint32_t> order(g.Nodes(), numeric_limits<uint32_t>::max());
+    vector<uint32_t> queue;
+    queue.reserve(g.Nodes());
+    uint32_t next = 0;
+    for (uint32_t root = 0; root < g.Nodes(); ++root) {
+        if (order[root] != numeric_limits<uint32_t>::max()) continue;
+        order[root] = next++;
+        queue.assign(1, root);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            uint32_t u = queue[head];
+            for (uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e) {
+                uint32_t v = g.neighbours[e];
+                if (order[v] != numeric_limits<uint32_t>::max()) continue;
+                order[v] = next++;
+                queue.push_back(v);
+            }
+        }
+    }
+    for (auto& e : edges) e = { order[e.first], order[e.second] };
+    return BuildGraph(g.Nodes(), move(edges));
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Undirected interaction graph in compressed sparse row form. The neighbours of
+// node u are neighbours[offsets[u]] .. neighbours[offsets[u + 1] - 1], sorted.
+// Each edge appears in both endpoints' rows; reverse[e] is the slot of the same
+// edge in the other row, so one match can fill both sides without searching.
+struct Graph {
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> neighbours;
+    std::vector<uint64_t> reverse;
+
+    size_t Nodes() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t Degree(size_t u) const { return static_cast<size_t>(offsets[u + 1] - offsets[u]); }
+};
+
+// Builds the CSR form from an edge list over nodes [0, nodes). Duplicate edges
+// and self-loops are dropped.
+Graph BuildGraph(size_t nodes, std::vector<std::pair<uint32_t, uint32_t>> edges);
+
+// width x height torus, nodes numbered row-major; von Neumann (4) or Moore (8) neighbourhood.
+Graph LatticeGraph(uint32_t width, uint32_t height, bool moore);
+
+// Reads "u v" pairs, one edge per line; lines starting with '#' or '%' are comments.
+// Node ids are arbitrary integers and are relabelled in breadth-first order, so
+// neighbours get nearby ids and their state sits close together in memory.
+Graph LoadEdgeList(const std::string& path);
@@ -0,0 +1,63 @@
+#pragma once
+#include "common.h"
+#include <cstdint>
+#include <vector>
+
+// Move histories are bit-packed, one bit per round (0 = C, 1 = D).
+
+// Read-only view handed to Strategy::decide. Cheap to copy; indexing, back() and
+// size() are O(1). Valid until the owning MoveHistory is modified.
+class HistoryView {
+private:
+    const uint64_t* words = nullptr;
+    size_t count = 0;
+
+public:
+    HistoryView() = default;
+    HistoryView(const uint64_t* w, size_t n) : words(w), count(n) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Move operator[](size_t k) const { return ((words[k >> 6] >> (k & 63)) & 1) ? Move::D : Move::C; }
+    Move front() const { return (*this)[0]; }
+    Move back() const { return (*this)[count - 1]; }
+    const uint64_t* data() const { return words; }
+
+    // Adapter for code that still wants one Move per element.
+    std::vector<Move> to_vector() const {
+        std::vector<Move> moves(count);
+        for (size_t k = 0; k < count; ++k) moves[k] = (*this)[k];
+        return moves;
+    }
+};
+
+// Owning, growable history. Reserve once for the match length and clear() between
+// matches to reuse the storage without touching the heap.
+class MoveHistory {
+private:
+    std::vector<uint64_t> words;
+    size_t count = 0;
+
+public:
+    void reserve(size_t rounds) {
+        size_t needed = (rounds + 63) / 64;
+        if (words.size() < needed) words.resize(needed);
+    }
+    void clear() { count = 0; }
+
+    void push_back(Move m) {
+        size_t w = count >> 6;
+        if (w == words.size()) words.push_back(0);
+        uint64_t bit = static_cast<uint64_t>(m == Move::D) << (count & 63);
+        words[w] = (count & 63) ? (words[w] | bit) : bit;
+        ++count;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Move operator[](size_t k) const { return view()[k]; }
+    Move back() const { return view().back(); }
+
+    HistoryView view() const { return { words.data(), count }; }
+    operator HistoryView() const { return view(); }
+};
@@ -0,0 +1,180 @@
+#include "Instrument.h"
+#include "Output.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+#if IPD_INSTRUMENT
+
+namespace {
+
+const char* kPhaseNames[] = { "decide", "noise", "outcome", "match", "fsm_batch", "fold",
+    "evaluate", "selection", "mutation", "spatial_update" };
+
+// Phases timed only inside sampled matches.
+bool Sampled(size_t phase) {
+    return phase == static_cast<size_t>(Phase::Decide) || phase == static_cast<size_t>(Phase::Noise)
+        || phase == static_cast<size_t>(Phase::Outcome);
+}
+
+// Cost of one clock read, charged to every lap of a sampled match; taken off
+// the round-loop phases so they are not dominated by the timer itself.
+double ClockOverheadNs() {
+    const int reads = 4096;
+    uint64_t start = NowNs(), last = start;
+    for (int k = 0; k < reads; ++k) last = NowNs();
+    return static_cast<double>(last - start) / reads;
+}
+
+}
+
+struct PairStats {
+    uint64_t matches = 0, rounds = 0, ns = 0;
+};
+
+struct ThreadStats {
+    uint64_t ns[static_cast<size_t>(Phase::Count)] = {};
+    uint64_t calls[static_cast<size_t>(Phase::Count)] = {};
+    uint64_t matches = 0, sampled = 0;
+    unordered_map<uint64_t, PairStats> pairs;
+    mutex m; // held only while recording into pairs and while reporting
+};
+
+namespace {
+
+mutex registry_m;
+vector<unique_ptr<ThreadStats>>& Registry() {
+    static vector<unique_ptr<ThreadStats>> registry;
+    return registry;
+}
+
+}
+
+ThreadStats& LocalStats() {
+    thread_local ThreadStats* local = nullptr;
+    if (!local) {
+        lock_guard<mutex> lk(registry_m);
+        Registry().push_back(make_unique<ThreadStats>());
+        local = Registry().back().get();
+    }
+    return *local;
+}
+
+void RecordPhase(ThreadStats& stats, Phase phase, uint64_t ns) {
+    stats.ns[static_cast<size_t>(phase)] += ns;
+    stats.calls[static_cast<size_t>(phase)]++;
+}
+
+void RecordPair(ThreadStats& stats, size_t i, size_t j, uint64_t matches, uint64_t rounds, uint64_t ns) {
+    RecordPhase(stats, Phase::Match, ns);
+    lock_guard<mutex> lk(stats.m);
+    auto& pair = stats.pairs[(static_cast<uint64_t>(i) << 32) | j];
+    pair.matches += matches;
+    pair.rounds += rounds;
+    pair.ns += ns;
+}
+
+bool SampleMatch(ThreadStats& stats) {
+    if (stats.matches++ % kSampleEvery != 0) return false;
+    stats.sampled++;
+    return true;
+}
+
+void WriteStatsReport(ostream& out, const vector<string>& names, bool json) {
+    const size_t phases = static_cast<size_t>(Phase::Count);
+    uint64_t ns[phases] = {}, calls[phases] = {};
+    uint64_t matches = 0, sampled = 0;
+    map<uint64_t, PairStats> pairs;
+    {
+        lock_guard<mutex> lk(registry_m);
+        for (auto& stats : Registry()) {
+            lock_guard<mutex> slk(stats->m);
+            for (size_t p = 0; p < phases; ++p) {
+                ns[p] += stats->ns[p];
+                calls[p] += stats->calls[p];
+            }
+            matches += stats->matches;
+            sampled += stats->sampled;
+            for (const auto& kv : stats->pairs) {
+                auto& pair = pairs[kv.first];
+                pair.matches += kv.second.matches;
+                pair.rounds += kv.second.rounds;
+                pair.ns += kv.second.ns;
+            }
+        }
+    }
+    // Round-loop phases are scaled from the sampled matches to all of them.
+    double scale = sampled ? static_cast<double>(matches) / sampled : 0.0;
+    const double overhead = ClockOverheadNs();
+    auto seconds = [&](size_t p) {
+        if (!Sampled(p)) return ns[p] * 1e-9;
+        return max(0.0, ns[p] - calls[p] * overhead) * 1e-9 * scale;
+    };
+    auto label = [&](size_t k) { return k < names.size() ? names[k] : to_string(k); };
+
+    PairStats total;
+    for (const auto& kv : pairs) {
+        total.matches += kv.second.matches;
+        total.rounds += kv.second.rounds;
+        total.ns += kv.second.ns;
+    }
+    auto rate = [](uint64_t count, uint64_t t) { return t ? count / (t * 1e-9) : 0.0; };
+
+    if (json) {
+        out << "{\"instrumented\":true,\"sample_every\":" << kSampleEvery
+            << ",\"matches\":" << total.matches << ",\"rounds\":" << total.rounds
+            << ",\"match_seconds\":" << total.ns * 1e-9
+            << ",\"matches_per_second\":" << rate(total.matches, total.ns)
+            << ",\"rounds_per_second\":" << rate(total.rounds, total.ns) << ",\"phases\":{";
+        for (size_t p = 0; p < phases; ++p) {
+            out << (p ? "," : "") << "\"" << kPhaseNames[p] << "\":{\"calls\":" << calls[p] << ",\"seconds\":" << seconds(p) << "}";
+        }
+        out << "},\"pairs\":[";
+        bool first = true;
+        for (const auto& kv : pairs) {
+            size_t i = kv.first >> 32, j = kv.first & 0xFFFFFFFFu;
+            out << (first ? "" : ",") << "{\"i\":" << i << ",\"j\":" << j
+                << ",\"strategy_i\":" << JsonString(label(i)) << ",\"strategy_j\":" << JsonString(label(j))
+                << ",\"matches\":" << kv.second.matches << ",\"rounds\":" << kv.second.rounds
+                << ",\"seconds\":" << kv.second.ns * 1e-9
+                << ",\"matches_per_second\":" << rate(kv.second.matches, kv.second.ns)
+                << ",\"rounds_per_second\":" << rate(kv.second.rounds, kv.second.ns) << "}";
+            first = false;
+        }
+        out << "]}\n";
+        return;
+    }
+
+    const ios::fmtflags flags = out.flags();
+    const streamsize precision = out.precision();
+    out << "--- Instrumentation (round-loop phases sampled 1 in " << kSampleEvery << " matches) ---\n";
+    out << left << setw(16) << "Phase" << setw(14) << "Calls" << setw(14) << "Seconds" << '\n';
+    for (size_t p = 0; p < phases; ++p) {
+        if (calls[p] == 0) continue;
+        out << left << setw(16) << kPhaseNames[p] << setw(14) << calls[p] << fixed << setprecision(6) << seconds(p) << '\n';
+    }
+    out << '\n' << left << setw(24) << "Pair" << setw(12) << "Matches" << setw(16) << "Matches/s" << "Rounds/s" << '\n';
+    for (const auto& kv : pairs) {
+        size_t i = kv.first >> 32, j = kv.first & 0xFFFFFFFFu;
+        out << left << setw(24) << (label(i) + "-" + label(j)) << setw(12) << kv.second.matches
+            << setprecision(0) << setw(16) << rate(kv.second.matches, kv.second.ns) << rate(kv.second.rounds, kv.second.ns) << '\n';
+    }
+    out << left << setw(24) << "all" << setw(12) << total.matches
+        << setprecision(0) << setw(16) << rate(total.matches, total.ns) << rate(total.rounds, total.ns) << '\n';
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#else
+
+void WriteStatsReport(ostream& out, const vector<string>&, bool json) {
+    if (json) out << "{\"instrumented\":false}\n";
+    else out << "Instrumentation not compiled in; configure with -DIPD_INSTRUMENT=ON.\n";
+}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#if IPD_INSTRUMENT
+#include <chrono>
+#endif
+
+// Hot-path instrumentation, compiled in with IPD_INSTRUMENT=1 (CMake option
+// IPD_INSTRUMENT). Without it every timer below is an empty inline class.
+//
+// Each thread records into its own counters, merged when reported. Coarse phases
+// and whole matches are timed every time; the phases inside a match's round loop
+// are timed for one match in kSampleEvery and scaled up in the report.
+
+enum class Phase { Decide, Noise, Outcome, Match, FsmBatch, Fold, Evaluate, Selection, Mutation, SpatialUpdate, Count };
+
+const uint32_t kSampleEvery = 64;
+
+#if IPD_INSTRUMENT
+
+struct ThreadStats;
+ThreadStats& LocalStats();
+void RecordPhase(ThreadStats& stats, Phase phase, uint64_t ns);
+void RecordPair(ThreadStats& stats, size_t i, size_t j, uint64_t matches, uint64_t rounds, uint64_t ns);
+bool SampleMatch(ThreadStats& stats);
+
+inline uint64_t NowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Times the enclosing scope as one call of phase.
+class PhaseScope {
+private:
+    Phase phase;
+    uint64_t start;
+
+public:
+    explicit PhaseScope(Phase p) : phase(p), start(NowNs()) {}
+    ~PhaseScope() { RecordPhase(LocalStats(), phase, NowNs() - start); }
+};
+
+// Splits a sampled match's round loop into phases: Lap(p) charges the time since
+// the previous lap to p. Does nothing for matches that are not sampled.
+class RoundTimer {
+private:
+    ThreadStats* stats;
+    uint64_t last;
+
+public:
+    RoundTimer() : stats(nullptr), last(0) {
+        ThreadStats& s = LocalStats();
+        if (SampleMatch(s)) {
+            stats = &s;
+            last = NowNs();
+        }
+    }
+    void Lap(Phase phase) {
+        if (!stats) return;
+        uint64_t now = NowNs();
+        RecordPhase(*stats, phase, now - last);
+        last = now;
+    }
+};
+
+// Times `matches` matches of pairing (i, j) played in the enclosing scope.
+class PairTimer {
+private:
+    size_t i, j;
+    uint64_t matches, rounds, start;
+
+public:
+    PairTimer(size_t a, size_t b, int match_rounds, uint64_t count = 1)
+        : i(a), j(b), matches(count), rounds(count * static_cast<uint64_t>(match_rounds)), start(NowNs()) {}
+    ~PairTimer() { RecordPair(LocalStats(), i, j, matches, rounds, NowNs() - start); }
+};
+
+#else
+
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase) {}
+};
+
+class RoundTimer {
+public:
+    void Lap(Phase) {}
+};
+
+class PairTimer {
+public:
+    PairTimer(size_t, size_t, int, uint64_t = 1) {}
+};
+
+#endif
+
+// Everything recorded so far, merged over threads: a table, or with json one
+// JSON object. names label the pairings. Without IPD_INSTRUMENT it says so.
+void WriteStatsReport(std::ostream& out, const std::vector<std::string>& names, bool json);
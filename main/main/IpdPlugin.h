@@ -0,0 +1,53 @@
+#pragma once
+/* Strategy plugin ABI. A plugin is a shared library (loaded with --plugin) that
+ * exports ipd_plugin_strategies, returning an array of strategy descriptions.
+ * Everything crossing the boundary is plain C, so plugins may be built with any
+ * compiler or language that can produce C symbols.
+ *
+ * Histories are bit-packed as in the engine: bit k & 63 of word k >> 6 is round
+ * k, 1 meaning defect. Bits at and above the round count are zero.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IPD_PLUGIN_ABI_VERSION 1
+
+typedef struct IpdStrategyApi {
+    uint32_t abi_version;       /* IPD_PLUGIN_ABI_VERSION */
+    const char* name;           /* strategy name, as used on --strategies */
+    int deterministic;          /* decisions depend on the histories only */
+
+    /* Per-match state. create is called once per engine instance of the strategy. */
+    void* (*create)(void);
+    void (*destroy)(void* state);
+    /* Start of a match. seed is drawn from the match's stream: a plugin that
+     * needs randomness seeds its own generator from it to stay reproducible. */
+    void (*reset)(void* state, uint64_t seed);
+
+    /* Next move (0 = cooperate, 1 = defect) after `rounds` rounds. */
+    int (*decide)(void* state, const uint64_t* self, const uint64_t* opp, uint64_t rounds);
+
+    /* Optional (may be NULL): decide for `lanes` independent matches at once,
+     * all after `rounds` rounds, writing each move to moves[k]. The engine uses
+     * it for the repeats of a pairing, so a call covers many matches. */
+    void (*decide_batch)(void* const* states, const uint64_t* const* self, const uint64_t* const* opp,
+        uint64_t rounds, size_t lanes, uint8_t* moves);
+} IpdStrategyApi;
+
+/* Exported by every plugin: its strategies and their number. The array must
+ * stay valid while the library is loaded. */
+typedef const IpdStrategyApi* (*IpdPluginStrategiesFn)(uint32_t* count);
+
+#if defined(_WIN32)
+#define IPD_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define IPD_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
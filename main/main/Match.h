@@ -10,7 +10,7 @@
 
 struct LPlayer {
     std::unique_ptr<Strategy> strat;
-    std::vector<Move> my, opp;
+    MoveHistory my, opp;
     double total = 0.0;
     LPlayer(Strategy* s) : strat(s) {}
     void reset_for_match() { my.clear(); opp.clear(); total = 0.0; strat->reset(); }
@@ -29,6 +29,8 @@ struct Match {
     }
     void Play() {
         A.reset_for_match(); B.reset_for_match();
+        A.my.reserve(rounds); A.opp.reserve(rounds);
+        B.my.reserve(rounds); B.opp.reserve(rounds);
         for (int i = 0; i < rounds; ++i) {
             Move mA = A.strat->decide(A.my, A.opp);
             Move mB = B.strat->decide(B.my, B.opp);
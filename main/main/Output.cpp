@@ -0,0 +1,395 @@
+#include "Output.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+// FILE with a large fully-buffered stream: records are appended without per-line flushes.
+// Write errors (a full disk) throw, so truncated output does not go unnoticed.
+class BufferedFile {
+private:
+    string path;
+    FILE* f = nullptr;
+    vector<char> buffer;
+
+    void Check(bool ok) {
+        if (!ok) throw runtime_error("Cannot write output file: " + path);
+    }
+
+public:
+    BufferedFile(const string& file, bool binary) : path(file), buffer(1 << 20) {
+        f = fopen(path.c_str(), binary ? "wb" : "w");
+        if (!f) throw runtime_error("Cannot open output file: " + path);
+        setvbuf(f, buffer.data(), _IOFBF, buffer.size());
+    }
+    ~BufferedFile() { if (f) fclose(f); }
+    BufferedFile(const BufferedFile&) = delete;
+    BufferedFile& operator=(const BufferedFile&) = delete;
+
+    void Write(const void* data, size_t size) { Check(fwrite(data, 1, size, f) == size); }
+    void Print(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int written = vfprintf(f, format, args);
+        va_end(args);
+        Check(written >= 0);
+    }
+    void Close() {
+        bool ok = fflush(f) == 0 && !ferror(f);
+        ok = fclose(f) == 0 && ok;
+        f = nullptr;
+        Check(ok);
+    }
+};
+
+class TextSink : public ResultSink {
+private:
+    bool header_printed = false;
+    vector<string> names;
+
+public:
+    void Begin(const vector<string>& strategies) override { names = strategies; }
+
+    void OnGeneration(int generation, const vector<StrategyResult>& results) override {
+        if (!header_printed) {
+            cout << "--- Evolutionary Dynamics ---\n";
+            header_printed = true;
+        }
+        cout << "Generation " << generation + 1 << ": ";
+        for (const auto& res : results) {
+            if (res.population > 0) {
+                cout << res.name << "(" << res.population << ") ";
+            }
+        }
+        cout << '\n';
+    }
+
+    void OnLeaderboard(const vector<StrategyResult>& results) override {
+        auto sorted_results = results;
+        sort(sorted_results.begin(), sorted_results.end(), [](const auto& a, const auto& b) {
+            return a.mean_score > b.mean_score;
+            });
+        // Generated names (see Space.h) can outgrow the default column.
+        size_t width = 20;
+        for (const auto& res : sorted_results) width = max(width, res.name.size() + 2);
+
+        cout << left << setw(width) << "Strategy"
+            << setw(15) << "Mean Score"
+            << setw(15) << "Std Dev"
+            << "95% CI" << '\n';
+        cout << string(width + 50, '-') << '\n';
+
+        for (const auto& res : sorted_results) {
+            cout << left << setw(width) << res.name
+                << fixed << setprecision(3) << setw(15) << res.mean_score
+                << setw(15) << res.stdev
+                << "[" << res.ci_lower << ", " << res.ci_upper << "]" << '\n';
+        }
+    }
+
+    void OnSweepPoint(size_t point, int rounds, double epsilon, const PayoffMatrix<double>& payoffs,
+        const vector<StrategyResult>& results) override {
+        if (point == 0) {
+            cout << left << setw(8) << "Rounds" << setw(10) << "Epsilon" << setw(20) << "T/R/P/S"
+                << setw(20) << "Strategy" << setw(15) << "Mean Score" << setw(15) << "Std Dev" << "95% CI" << '\n';
+            cout << string(108, '-') << '\n';
+        }
+        ostringstream eps, matrix;
+        eps << epsilon;
+        matrix << payoffs.T_temptation << "/" << payoffs.R_reward << "/" << payoffs.P_punishment << "/" << payoffs.S_sucker;
+        for (const auto& res : results) {
+            cout << left << setw(8) << rounds << setw(10) << eps.str() << setw(20) << matrix.str()
+                << setw(20) << res.name
+                << fixed << setprecision(3) << setw(15) << res.mean_score
+                << setw(15) << res.stdev
+                << "[" << res.ci_lower << ", " << res.ci_upper << "]" << '\n';
+        }
+    }
+
+    void OnFixation(int population, const vector<FixationResult>& results) override {
+        // Rows are residents, columns mutants; above 1/N a mutant is favoured.
+        size_t width = 12;
+        for (const auto& name : names) width = max(width, name.size() + 2);
+        cout << "--- Fixation Probabilities (population " << population << ", neutral 1/N = "
+            << fixed << setprecision(4) << 1.0 / population << ") ---\n";
+        cout << left << setw(width) << "Resident";
+        for (const auto& name : names) cout << setw(width) << name;
+        cout << '\n' << string(width * (names.size() + 1), '-') << '\n';
+        vector<double> matrix(names.size() * names.size(), -1.0);
+        for (const auto& res : results) matrix[res.resident * names.size() + res.mutant] = res.probability;
+        for (size_t b = 0; b < names.size(); ++b) {
+            cout << setw(width) << names[b];
+            for (size_t m = 0; m < names.size(); ++m) {
+                double p = matrix[b * names.size() + m];
+                if (p < 0.0) cout << setw(width) << "-";
+                else cout << setw(width) << p;
+            }
+            cout << '\n';
+        }
+    }
+
+    void End() override { cout.flush(); }
+};
+
+// Shared plumbing for the file formats: one lazily opened file per table.
+class TableSink : public ResultSink {
+protected:
+    enum Table { MATCHES, GENERATIONS, LEADERBOARD, SWEEP, TRACES, FIXATION };
+
+    string base, extension;
+    bool binary;
+    vector<string> names;
+    unique_ptr<BufferedFile> files[6];
+
+    BufferedFile& Open(Table table) {
+        if (!files[table]) {
+            static const char* table_names[] = { "matches", "generations", "leaderboard", "sweep", "traces", "fixation" };
+            files[table] = make_unique<BufferedFile>(base + "." + table_names[table] + "." + extension, binary);
+            WriteHeader(table, *files[table]);
+        }
+        return *files[table];
+    }
+
+    virtual void WriteHeader(Table table, BufferedFile& file) = 0;
+
+public:
+    TableSink(string b, string ext, bool bin) : base(move(b)), extension(move(ext)), binary(bin) {}
+
+    void Begin(const vector<string>& strategies) override {
+        names = strategies;
+    }
+
+    void End() override {
+        for (auto& f : files) if (f) f->Close();
+    }
+};
+
+size_t Words(int rounds) { return (static_cast<size_t>(rounds) + 63) / 64; }
+
+// One packed history as a "CDDC..." string.
+string Moves(const uint64_t* words, int rounds) {
+    string out(rounds, 'C');
+    for (int k = 0; k < rounds; ++k) {
+        if ((words[k >> 6] >> (k & 63)) & 1) out[k] = 'D';
+    }
+    return out;
+}
+
+// A CSV field, quoted as in RFC 4180 when it holds a comma, quote or line break
+// (generated space names such as "S0:0.60,0.75,0.10,0.42" do).
+string CsvField(const string& s) {
+    if (s.find_first_of(",\"\r\n") == string::npos) return s;
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+class CsvSink : public TableSink {
+protected:
+    void WriteHeader(Table table, BufferedFile& file) override {
+        if (table == MATCHES) file.Print("rep,i,j,strategy_i,strategy_j,score_i,score_j\n");
+        if (table == GENERATIONS) file.Print("generation,strategy,population,mean_score\n");
+        if (table == LEADERBOARD) file.Print("strategy,mean_score,stdev,ci_lower,ci_upper\n");
+        if (table == SWEEP) file.Print("point,rounds,epsilon,T,R,P,S,strategy,mean_score,stdev,ci_lower,ci_upper\n");
+        if (table == TRACES) file.Print("rep,i,j,moves_i,moves_j\n");
+        if (table == FIXATION) file.Print("population,resident,mutant,probability,ci_lower,ci_upper,trials,fixations,exact\n");
+    }
+
+public:
+    explicit CsvSink(const string& base) : TableSink(base, "csv", false) {}
+
+    void OnMatch(int rep, size_t i, size_t j, double score_i, double score_j) override {
+        Open(MATCHES).Print("%d,%zu,%zu,%s,%s,%.17g,%.17g\n", rep, i, j, CsvField(names[i]).c_str(), CsvField(names[j]).c_str(), score_i, score_j);
+    }
+    void OnTrace(int rep, size_t i, size_t j, int rounds, const uint64_t* trace) override {
+        Open(TRACES).Print("%d,%zu,%zu,%s,%s\n", rep, i, j, Moves(trace, rounds).c_str(), Moves(trace + Words(rounds), rounds).c_str());
+    }
+    void OnGeneration(int generation, const vector<StrategyResult>& results) override {
+        auto& file = Open(GENERATIONS);
+        for (const auto& res : results) {
+            file.Print("%d,%s,%d,%.17g\n", generation, CsvField(res.name).c_str(), res.population, res.mean_score);
+        }
+    }
+    void OnLeaderboard(const vector<StrategyResult>& results) override {
+        auto& file = Open(LEADERBOARD);
+        for (const auto& res : results) {
+            file.Print("%s,%.17g,%.17g,%.17g,%.17g\n", CsvField(res.name).c_str(), res.mean_score, res.stdev, res.ci_lower, res.ci_upper);
+        }
+    }
+    void OnSweepPoint(size_t point, int rounds, double epsilon, const PayoffMatrix<double>& payoffs,
+        const vector<StrategyResult>& results) override {
+        auto& file = Open(SWEEP);
+        for (const auto& res : results) {
+            file.Print("%zu,%d,%.17g,%.17g,%.17g,%.17g,%.17g,%s,%.17g,%.17g,%.17g,%.17g\n", point, rounds, epsilon,
+                payoffs.T_temptation, payoffs.R_reward, payoffs.P_punishment, payoffs.S_sucker,
+                CsvField(res.name).c_str(), res.mean_score, res.stdev, res.ci_lower, res.ci_upper);
+        }
+    }
+    void OnFixation(int population, const vector<FixationResult>& results) override {
+        auto& file = Open(FIXATION);
+        for (const auto& res : results) {
+            file.Print("%d,%s,%s,%.17g,%.17g,%.17g,%llu,%llu,%.17g\n", population, CsvField(names[res.resident]).c_str(),
+                CsvField(names[res.mutant]).c_str(), res.probability, res.ci_lower, res.ci_upper,
+                static_cast<unsigned long long>(res.trials), static_cast<unsigned long long>(res.fixations), res.exact);
+        }
+    }
+};
+
+class JsonlSink : public TableSink {
+protected:
+    void WriteHeader(Table, BufferedFile&) override {}
+
+public:
+    explicit JsonlSink(const string& base) : TableSink(base, "jsonl", false) {}
+
+    void OnMatch(int rep, size_t i, size_t j, double score_i, double score_j) override {
+        Open(MATCHES).Print("{\"rep\":%d,\"i\":%zu,\"j\":%zu,\"strategy_i\":%s,\"strategy_j\":%s,\"score_i\":%.17g,\"score_j\":%.17g}\n",
+            rep, i, j, JsonString(names[i]).c_str(), JsonString(names[j]).c_str(), score_i, score_j);
+    }
+    void OnTrace(int rep, size_t i, size_t j, int rounds, const uint64_t* trace) override {
+        Open(TRACES).Print("{\"rep\":%d,\"i\":%zu,\"j\":%zu,\"moves_i\":\"%s\",\"moves_j\":\"%s\"}\n",
+            rep, i, j, Moves(trace, rounds).c_str(), Moves(trace + Words(rounds), rounds).c_str());
+    }
+    void OnGeneration(int generation, const vector<StrategyResult>& results) override {
+        auto& file = Open(GENERATIONS);
+        for (const auto& res : results) {
+            file.Print("{\"generation\":%d,\"strategy\":%s,\"population\":%d,\"mean_score\":%.17g}\n",
+                generation, JsonString(res.name).c_str(), res.population, res.mean_score);
+        }
+    }
+    void OnLeaderboard(const vector<StrategyResult>& results) override {
+        auto& file = Open(LEADERBOARD);
+        for (const auto& res : results) {
+            file.Print("{\"strategy\":%s,\"mean_score\":%.17g,\"stdev\":%.17g,\"ci_lower\":%.17g,\"ci_upper\":%.17g}\n",
+                JsonString(res.name).c_str(), res.mean_score, res.stdev, res.ci_lower, res.ci_upper);
+        }
+    }
+    void OnSweepPoint(size_t point, int rounds, double epsilon, const PayoffMatrix<double>& payoffs,
+        const vector<StrategyResult>& results) override {
+        auto& file = Open(SWEEP);
+        for (const auto& res : results) {
+            file.Print("{\"point\":%zu,\"rounds\":%d,\"epsilon\":%.17g,\"payoffs\":[%.17g,%.17g,%.17g,%.17g],"
+                "\"strategy\":%s,\"mean_score\":%.17g,\"stdev\":%.17g,\"ci_lower\":%.17g,\"ci_upper\":%.17g}\n",
+                point, rounds, epsilon, payoffs.T_temptation, payoffs.R_reward, payoffs.P_punishment, payoffs.S_sucker,
+                JsonString(res.name).c_str(), res.mean_score, res.stdev, res.ci_lower, res.ci_upper);
+        }
+    }
+    void OnFixation(int population, const vector<FixationResult>& results) override {
+        auto& file = Open(FIXATION);
+        for (const auto& res : results) {
+            file.Print("{\"population\":%d,\"resident\":%s,\"mutant\":%s,\"probability\":%.17g,\"ci_lower\":%.17g,"
+                "\"ci_upper\":%.17g,\"trials\":%llu,\"fixations\":%llu,\"exact\":%.17g}\n",
+                population, JsonString(names[res.resident]).c_str(), JsonString(names[res.mutant]).c_str(),
+                res.probability, res.ci_lower, res.ci_upper, static_cast<unsigned long long>(res.trials),
+                static_cast<unsigned long long>(res.fixations), res.exact);
+        }
+    }
+};
+
+class BinarySink : public TableSink {
+private:
+    uint32_t trace_record_size = 0;
+
+protected:
+    void WriteHeader(Table table, BufferedFile& file) override {
+        static const uint32_t sizes[] = { sizeof(MatchRecord), sizeof(GenerationRecord), sizeof(LeaderboardRecord), sizeof(SweepRecord), 0,
+            sizeof(FixationRecord) };
+        BinaryHeader header{};
+        memcpy(header.magic, "IPDBIN1", 8);
+        header.record_kind = static_cast<uint32_t>(table) + 1;
+        header.record_size = table == TRACES ? trace_record_size : sizes[table];
+        header.strategy_count = static_cast<uint32_t>(names.size());
+
+        uint64_t offset = sizeof(BinaryHeader);
+        for (const auto& name : names) offset += sizeof(uint32_t) + name.size();
+        header.data_offset = (offset + 7) & ~uint64_t(7);
+        file.Write(&header, sizeof(header));
+        for (const auto& name : names) {
+            uint32_t length = static_cast<uint32_t>(name.size());
+            file.Write(&length, sizeof(length));
+            file.Write(name.data(), name.size());
+        }
+        static const char padding[8] = {};
+        file.Write(padding, header.data_offset - offset);
+    }
+
+public:
+    explicit BinarySink(const string& base) : TableSink(base, "bin", true) {}
+
+    void OnMatch(int rep, size_t i, size_t j, double score_i, double score_j) override {
+        MatchRecord r{ static_cast<uint32_t>(rep), static_cast<uint32_t>(i), static_cast<uint32_t>(j), 0, score_i, score_j };
+        Open(MATCHES).Write(&r, sizeof(r));
+    }
+    void OnTrace(int rep, size_t i, size_t j, int rounds, const uint64_t* trace) override {
+        size_t words = 2 * Words(rounds);
+        trace_record_size = static_cast<uint32_t>(sizeof(TraceRecord) + words * sizeof(uint64_t));
+        auto& file = Open(TRACES);
+        TraceRecord r{ static_cast<uint32_t>(rep), static_cast<uint32_t>(i), static_cast<uint32_t>(j), static_cast<uint32_t>(rounds) };
+        file.Write(&r, sizeof(r));
+        file.Write(trace, words * sizeof(uint64_t));
+    }
+    void OnGeneration(int generation, const vector<StrategyResult>& results) override {
+        auto& file = Open(GENERATIONS);
+        for (const auto& res : results) {
+            GenerationRecord r{ static_cast<uint32_t>(generation), static_cast<uint32_t>(res.strategy), res.population, res.mean_score };
+            file.Write(&r, sizeof(r));
+        }
+    }
+    void OnLeaderboard(const vector<StrategyResult>& results) override {
+        auto& file = Open(LEADERBOARD);
+        for (const auto& res : results) {
+            LeaderboardRecord r{ static_cast<uint32_t>(res.strategy), 0, res.mean_score, res.stdev, res.ci_lower, res.ci_upper };
+            file.Write(&r, sizeof(r));
+        }
+    }
+    void OnSweepPoint(size_t point, int rounds, double epsilon, const PayoffMatrix<double>& payoffs,
+        const vector<StrategyResult>& results) override {
+        auto& file = Open(SWEEP);
+        for (const auto& res : results) {
+            SweepRecord r{ static_cast<uint32_t>(point), static_cast<uint32_t>(res.strategy), rounds, 0, epsilon,
+                payoffs.T_temptation, payoffs.R_reward, payoffs.P_punishment, payoffs.S_sucker,
+                res.mean_score, res.stdev, res.ci_lower, res.ci_upper };
+            file.Write(&r, sizeof(r));
+        }
+    }
+    void OnFixation(int population, const vector<FixationResult>& results) override {
+        auto& file = Open(FIXATION);
+        for (const auto& res : results) {
+            FixationRecord r{ static_cast<uint32_t>(res.resident), static_cast<uint32_t>(res.mutant), population, 0,
+                res.trials, res.fixations, res.probability, res.ci_lower, res.ci_upper, res.exact };
+            file.Write(&r, sizeof(r));
+        }
+    }
+};
+
+}
+
+string JsonString(const string& s) {
+    string out = "\"";
+    for (char c : s) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+            continue;
+        }
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+unique_ptr<ResultSink> CreateResultSink(const string& format, const string& base) {
+    if (format == "text") return make_unique<TextSink>();
+    if (format == "csv") return make_unique<CsvSink>(base);
+    if (format == "jsonl") return make_unique<JsonlSink>(base);
+    if (format == "binary") return make_unique<BinarySink>(base);
+    throw runtime_error("Unknown format: " + format);
+}
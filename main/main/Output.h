@@ -0,0 +1,78 @@
+#pragma once
+#include "common.h"
+#include <cstdio>
+#include <memory>
+
+// Receives results while the Engine produces them, so nothing has to be kept
+// in memory until the end of a run. Engine calls Begin and End around each run.
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+    virtual void Begin(const std::vector<std::string>&) {}
+    virtual void OnMatch(int, size_t, size_t, double, double) {}
+    // Moves of one match, packed as by CountMatch; comes just before its OnMatch.
+    virtual void OnTrace(int, size_t, size_t, int, const uint64_t*) {}
+    virtual void OnGeneration(int, const std::vector<StrategyResult>&) {}
+    virtual void OnLeaderboard(const std::vector<StrategyResult>&) {}
+    virtual void OnSweepPoint(size_t, int, double, const PayoffMatrix<double>&, const std::vector<StrategyResult>&) {}
+    // Every ordered (resident, mutant) pair of a fixation run in a population of the given size.
+    virtual void OnFixation(int, const std::vector<FixationResult>&) {}
+    virtual void End() {}
+};
+
+// Sinks by --format: "text" prints to stdout as before; "csv", "jsonl" and
+// "binary" stream to <base>.matches.*, <base>.generations.*,
+// <base>.leaderboard.*, <base>.sweep.*, <base>.traces.* and <base>.fixation.*,
+// created on first use.
+std::unique_ptr<ResultSink> CreateResultSink(const std::string& format, const std::string& base);
+
+// s as a quoted JSON string literal.
+std::string JsonString(const std::string& s);
+
+// Binary tables: a BinaryHeader, the strategy names, then fixed-size little-endian
+// records from data_offset to the end of the file, so a reader can mmap the file
+// and index the records directly. Record count = (file size - data_offset) / record_size.
+struct BinaryHeader {
+    char magic[8];        // "IPDBIN1"
+    uint32_t record_kind; // 1 = match, 2 = generation, 3 = leaderboard, 4 = sweep, 5 = trace, 6 = fixation
+    uint32_t record_size;
+    uint32_t strategy_count;
+    uint32_t reserved;
+    uint64_t data_offset; // names are stored as uint32 length + bytes, then padded to 8
+};
+
+struct MatchRecord {
+    uint32_t rep, i, j, reserved;
+    double score_i, score_j;
+};
+
+struct GenerationRecord {
+    uint32_t generation, strategy;
+    int64_t population;
+    double mean_score;
+};
+
+struct LeaderboardRecord {
+    uint32_t strategy, reserved;
+    double mean_score, stdev, ci_lower, ci_upper;
+};
+
+struct SweepRecord {
+    uint32_t point, strategy;
+    int32_t rounds, reserved;
+    double epsilon, temptation, reward, punishment, sucker;
+    double mean_score, stdev, ci_lower, ci_upper;
+};
+
+// Followed by the packed moves: (rounds + 63) / 64 words for i, then for j.
+// record_size covers both, and is the same for every record of a file.
+struct TraceRecord {
+    uint32_t rep, i, j, rounds;
+};
+
+struct FixationRecord {
+    uint32_t resident, mutant;
+    int32_t population, reserved;
+    uint64_t trials, fixations;
+    double probability, ci_lower, ci_upper, exact;
+};
@@ -9,8 +9,8 @@
 class Player {
 private:
     std::unique_ptr<Strategy> strategy;
-    std::vector<Move> myMoves;
-    std::vector<Move> oppMoves;
+    MoveHistory myMoves;
+    MoveHistory oppMoves;
     int score = 0;
 
 public:
@@ -29,7 +29,7 @@ public:
     int GetScore() const { return score; }
 
     const std::string GetName() const { return strategy->name(); }
-    const std::vector<Move>& GetMyMoves() const { return myMoves; }
+    const MoveHistory& GetMyMoves() const { return myMoves; }
 };
 
 #endif
@@ -0,0 +1,179 @@
+#include "Plugin.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+mutex plugins_m;
+
+IpdPluginStrategiesFn OpenPlugin(const string& path) {
+#if defined(_WIN32)
+    HMODULE library = LoadLibraryA(path.c_str());
+    if (!library) throw runtime_error("Cannot load plugin " + path + ": error " + to_string(GetLastError()));
+    auto entry = reinterpret_cast<IpdPluginStrategiesFn>(GetProcAddress(library, "ipd_plugin_strategies"));
+#else
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) throw runtime_error("Cannot load plugin " + path + ": " + dlerror());
+    auto entry = reinterpret_cast<IpdPluginStrategiesFn>(dlsym(library, "ipd_plugin_strategies"));
+#endif
+    if (!entry) throw runtime_error("Plugin " + path + " does not export ipd_plugin_strategies");
+    return entry;
+}
+
+Move Flip(Move m, uint64_t flip) { return static_cast<Move>(static_cast<int>(m) ^ static_cast<int>(flip)); }
+
+}
+
+void LoadPlugin(const string& path) {
+    lock_guard<mutex> lk(plugins_m);
+    // Path -> modification time when loaded. A long-running service cannot load
+    // a rebuilt library over the old one, so it says so instead of running stale code.
+    static map<string, filesystem::file_time_type> loaded;
+    error_code ec;
+    auto modified = filesystem::last_write_time(path, ec);
+    auto it = loaded.find(path);
+    if (it != loaded.end()) {
+        if (!ec && modified != it->second) throw runtime_error("Plugin " + path + " changed since it was loaded; restart to load the new build");
+        return;
+    }
+
+    uint32_t count = 0;
+    const IpdStrategyApi* strategies = OpenPlugin(path)(&count);
+    // Check every entry before registering any, so a bad library registers nothing.
+    set<string> names;
+    for (uint32_t k = 0; k < count; ++k) {
+        const IpdStrategyApi* api = &strategies[k];
+        if (api->abi_version != IPD_PLUGIN_ABI_VERSION) {
+            throw runtime_error("Plugin " + path + " was built for ABI version " + to_string(api->abi_version)
+                + ", this engine has " + to_string(IPD_PLUGIN_ABI_VERSION));
+        }
+        if (!api->name || !api->create || !api->destroy || !api->reset || !api->decide) {
+            throw runtime_error("Plugin " + path + " has an incomplete strategy entry");
+        }
+        string name = api->name;
+        transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(toupper(c)); });
+        if (IsRegisteredStrategy(name) || !names.insert(name).second) {
+            throw runtime_error("Plugin " + path + " registers " + api->name + ", which is already a strategy");
+        }
+    }
+    for (uint32_t k = 0; k < count; ++k) {
+        const IpdStrategyApi* api = &strategies[k];
+        RegisterStrategy(api->name, [api]() { return make_unique<PluginStrategy>(api); });
+    }
+    loaded.emplace(path, modified);
+}
+
+PluginStrategy::PluginStrategy(const IpdStrategyApi* strategy_api) : api(strategy_api), state(strategy_api->create()) {}
+
+PluginStrategy::~PluginStrategy() {
+    api->destroy(state);
+}
+
+void PluginStrategy::reset() {
+    api->reset(state, rng());
+}
+
+Move PluginStrategy::decide(const History& self_history, const History& opp_history) {
+    return api->decide(state, self_history.data(), opp_history.data(), self_history.size()) ? Move::D : Move::C;
+}
+
+void PluginStrategy::DecideBatch(Strategy* const* players, size_t lanes, const History* self, const History* opp, Move* out) {
+    if (lanes == 0) return;
+    const IpdStrategyApi* api = static_cast<PluginStrategy*>(players[0])->api;
+    if (!api->decide_batch) {
+        for (size_t k = 0; k < lanes; ++k) out[k] = players[k]->decide(self[k], opp[k]);
+        return;
+    }
+    vector<void*> states(lanes);
+    vector<const uint64_t*> self_words(lanes), opp_words(lanes);
+    vector<uint8_t> moves(lanes);
+    for (size_t k = 0; k < lanes; ++k) {
+        states[k] = static_cast<PluginStrategy*>(players[k])->state;
+        self_words[k] = self[k].data();
+        opp_words[k] = opp[k].data();
+    }
+    api->decide_batch(states.data(), self_words.data(), opp_words.data(), self[0].size(), lanes, moves.data());
+    for (size_t k = 0; k < lanes; ++k) out[k] = moves[k] ? Move::D : Move::C;
+}
+
+void CountMatchLanes(Strategy* const* a, Strategy* const* b, size_t lanes, int rounds, const Noise& noise,
+    const uint64_t* seeds, OutcomeCounts* out) {
+    // Each lane owns a stream. Around calls that may draw from rng the lane's
+    // generator is swapped in, so draws happen in the same order as in CountMatch.
+    vector<Rng> gens(lanes);
+    for (size_t k = 0; k < lanes; ++k) {
+        gens[k].Seed(seeds[k]);
+        swap(rng, gens[k]);
+        a[k]->reset();
+        b[k]->reset();
+        swap(rng, gens[k]);
+    }
+
+    const bool plugin_a = dynamic_cast<PluginStrategy*>(a[0]) != nullptr;
+    const bool plugin_b = dynamic_cast<PluginStrategy*>(b[0]) != nullptr;
+    const bool noisy = !noise.None(), perception = noisy && noise.model == NoiseModel::Perception;
+    const uint64_t threshold1 = NoiseThreshold(noise.p1), threshold2 = NoiseThreshold(noise.p2);
+
+    // view1 / view2: the opponent's moves as player 1 / player 2 perceived them.
+    vector<MoveHistory> h1(lanes), h2(lanes), view1(perception ? lanes : 0), view2(perception ? lanes : 0);
+    for (auto* h : { &h1, &h2, &view1, &view2 }) {
+        for (auto& history : *h) history.reserve(rounds);
+    }
+    vector<History> self(lanes), opp(lanes);
+    vector<Move> m1(lanes), m2(lanes);
+    vector<uint64_t> flips1(lanes, 0), flips2(lanes, 0);
+    vector<array<int, 4>> outcomes(lanes, array<int, 4>{});
+
+    auto decide = [&](Strategy* const* players, bool plugin, const vector<MoveHistory>& mine,
+        const vector<MoveHistory>& theirs, vector<Move>& moves) {
+        for (size_t k = 0; k < lanes; ++k) {
+            self[k] = mine[k].view();
+            opp[k] = theirs[k].view();
+        }
+        if (plugin) {
+            PluginStrategy::DecideBatch(players, lanes, self.data(), opp.data(), moves.data());
+            return;
+        }
+        for (size_t k = 0; k < lanes; ++k) {
+            swap(rng, gens[k]);
+            moves[k] = players[k]->decide(self[k], opp[k]);
+            swap(rng, gens[k]);
+        }
+    };
+
+    for (int i = 0; i < rounds; ++i) {
+        int bit = i & 63;
+        if (noisy && bit == 0) {
+            for (size_t k = 0; k < lanes; ++k) NoiseMasks(gens[k], threshold1, threshold2, min(64, rounds - i), flips1[k], flips2[k]);
+        }
+        decide(a, plugin_a, h1, perception ? view1 : h2, m1);
+        decide(b, plugin_b, h2, perception ? view2 : h1, m2);
+        for (size_t k = 0; k < lanes; ++k) {
+            uint64_t f1 = (flips1[k] >> bit) & 1, f2 = (flips2[k] >> bit) & 1;
+            Move x1 = perception ? m1[k] : Flip(m1[k], f1);
+            Move x2 = perception ? m2[k] : Flip(m2[k], f2);
+            outcomes[k][(x1 == Move::D) * 2 + (x2 == Move::D)]++;
+            h1[k].push_back(x1);
+            h2[k].push_back(x2);
+            if (perception) {
+                view1[k].push_back(Flip(x2, f1));
+                view2[k].push_back(Flip(x1, f2));
+            }
+        }
+    }
+    for (size_t k = 0; k < lanes; ++k) {
+        out[k] = { double(outcomes[k][0]), double(outcomes[k][1]), double(outcomes[k][2]), double(outcomes[k][3]) };
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Strategy.h"
+#include "IpdPlugin.h"
+
+// Loads a strategy plugin (see IpdPlugin.h) and registers its strategies with
+// CreateStrategy. The library stays loaded for the life of the process; loading
+// the same path twice is a no-op, and an error if the file changed in between.
+void LoadPlugin(const std::string& path);
+
+// A strategy implemented in a plugin. decide() is one call across the ABI.
+class PluginStrategy final : public Strategy {
+private:
+    const IpdStrategyApi* api;
+    void* state;
+
+public:
+    explicit PluginStrategy(const IpdStrategyApi* strategy_api);
+    ~PluginStrategy() override;
+    PluginStrategy(const PluginStrategy&) = delete;
+    PluginStrategy& operator=(const PluginStrategy&) = delete;
+
+    // Seeds the plugin from one draw of the calling thread's rng.
+    void reset() override;
+    Move decide(const History& self_history, const History& opp_history) override;
+    string name() const override { return api->name; }
+    bool is_deterministic() const override { return api->deterministic != 0; }
+    // A clone gets fresh plugin state from create; plugins only start from reset.
+    unique_ptr<Strategy> clone() const override { return make_unique<PluginStrategy>(api); }
+    Strategy* clone_into(pmr::memory_resource& arena) const override {
+        return new (arena.allocate(sizeof(PluginStrategy), alignof(PluginStrategy))) PluginStrategy(api);
+    }
+
+    // One decision for each of lanes matches, players[k] playing with histories
+    // self[k] / opp[k] of equal length; every player must come from the same
+    // plugin strategy. One decide_batch call when the plugin has one.
+    static void DecideBatch(Strategy* const* players, size_t lanes, const History* self, const History* opp, Move* out);
+};
+
+// Plays lanes matches between a[k] and b[k], lane k
+// giving exactly what CountMatch does after Seed_Match_Stream(seeds[k]). Each
+// side that is a plugin decides for all lanes in one DecideBatch per round.
+void CountMatchLanes(Strategy* const* a, Strategy* const* b, size_t lanes, int rounds, const Noise& noise,
+    const uint64_t* seeds, OutcomeCounts* out);
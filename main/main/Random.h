@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+// xoshiro256** (Blackman & Vigna). Seeding is four splitmix64 steps, cheap enough
+// to reseed for every match; streams are seeded from MatchSeed hashes rather than
+// by jump-ahead. It satisfies UniformRandomBitGenerator so the <random>
+// distributions accept it.
+class Xoshiro256 {
+private:
+    uint64_t s[4];
+
+    static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    using result_type = uint64_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint64_t>::max(); }
+
+    explicit Xoshiro256(uint64_t seed = 0) { Seed(seed); }
+
+    void Seed(uint64_t seed) {
+        for (auto& word : s) {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    result_type operator()() {
+        uint64_t result = Rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1) from the top 53 bits.
+    double Uniform() { return static_cast<double>((*this)() >> 11) * 0x1.0p-53; }
+};
+
+// The generator behind the match streams; swap the alias to change it everywhere.
+using Rng = Xoshiro256;
+
+// Noise is drawn with 32-bit integer comparisons: a draw flips a move when its
+// 32 bits are below epsilon * 2^32 (epsilon 1 gives 2^32, always below).
+inline uint64_t NoiseThreshold(double epsilon) {
+    if (epsilon <= 0.0) return 0;
+    if (epsilon >= 1.0) return uint64_t(1) << 32;
+    return static_cast<uint64_t>(epsilon * 4294967296.0);
+}
+
+// Flip masks for a block of up to 64 rounds: bit k of flips1 / flips2 is set when
+// round k of the block flips for player 1 / player 2, under threshold1 / threshold2.
+// One 64-bit draw per round covers both players.
+inline void NoiseMasks(Rng& gen, uint64_t threshold1, uint64_t threshold2, int count, uint64_t& flips1, uint64_t& flips2) {
+    uint64_t m1 = 0, m2 = 0;
+    for (int k = 0; k < count; ++k) {
+        uint64_t x = gen();
+        m1 |= uint64_t((x & 0xFFFFFFFFu) < threshold1) << k;
+        m2 |= uint64_t((x >> 32) < threshold2) << k;
+    }
+    flips1 = m1;
+    flips2 = m2;
+}
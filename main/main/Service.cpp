@@ -0,0 +1,298 @@
+#include "Service.h"
+#include "ThreadPool.h"
+#include "Counts.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#if defined(_WIN32)
+
+void RunService(const string&, unsigned int, size_t, const ServiceJobRunner&) {
+    throw runtime_error("--serve needs Unix domain sockets, which this build does not support");
+}
+
+int RunClient(const string&, const vector<string>&) {
+    throw runtime_error("--client needs Unix domain sockets, which this build does not support");
+}
+
+#else
+
+namespace {
+
+// Wire format: a request is uint32 count and count strings (the client's
+// working directory, then the arguments); a response is int32 exit status,
+// then the job's cout and cerr. A string is uint32 length and bytes.
+
+bool ReadAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size) {
+        ssize_t got = recv(fd, p, size, 0);
+        if (got <= 0) return false;
+        p += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool WriteAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size) {
+        ssize_t put = send(fd, p, size, MSG_NOSIGNAL);
+        if (put <= 0) return false;
+        p += put;
+        size -= static_cast<size_t>(put);
+    }
+    return true;
+}
+
+bool ReadString(int fd, string& s) {
+    uint32_t size = 0;
+    if (!ReadAll(fd, &size, sizeof(size))) return false;
+    s.resize(size);
+    return size == 0 || ReadAll(fd, &s[0], size);
+}
+
+bool WriteString(int fd, const string& s) {
+    uint32_t size = static_cast<uint32_t>(s.size());
+    return WriteAll(fd, &size, sizeof(size)) && WriteAll(fd, s.data(), s.size());
+}
+
+bool Reply(int fd, int32_t status, const string& out, const string& err) {
+    return WriteAll(fd, &status, sizeof(status)) && WriteString(fd, out) && WriteString(fd, err);
+}
+
+// Jobs can load plugins and write files anywhere the service can, so only the
+// service's own user may submit them.
+bool SameUser(int fd) {
+#if defined(__linux__)
+    ucred peer{};
+    socklen_t size = sizeof(peer);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && peer.uid == geteuid();
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+// A client that stops sending or reading is dropped after this long, so it
+// cannot hold up a --stop.
+const int kClientTimeoutSeconds = 30;
+
+sockaddr_un SocketAddress(const string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw runtime_error("Socket path is too long: " + path);
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+struct Job {
+    uint64_t id = 0;
+    string cwd;
+    vector<string> args;
+    bool done = false;
+    int status = 0;
+    string out, err;
+};
+
+// Jobs in arrival order; a job identical to a pending one is merged into it.
+class JobQueue {
+private:
+    mutex m;
+    condition_variable cv;
+    deque<shared_ptr<Job>> queue;
+    map<pair<string, vector<string>>, shared_ptr<Job>> pending;
+    uint64_t next_id = 1;
+    bool stopping = false;
+
+public:
+    // nullptr once stopped.
+    shared_ptr<Job> Submit(const string& cwd, const vector<string>& args) {
+        lock_guard<mutex> lk(m);
+        if (stopping) return nullptr;
+        auto& job = pending[{ cwd, args }];
+        if (!job) {
+            job = make_shared<Job>();
+            job->id = next_id++;
+            job->cwd = cwd;
+            job->args = args;
+            queue.push_back(job);
+            cv.notify_all();
+        }
+        return job;
+    }
+
+    // The next job, or nullptr once stopped and drained.
+    shared_ptr<Job> Next() {
+        unique_lock<mutex> lk(m);
+        cv.wait(lk, [&] { return !queue.empty() || stopping; });
+        if (queue.empty()) return nullptr;
+        auto job = queue.front();
+        queue.pop_front();
+        return job;
+    }
+
+    void Finish(const shared_ptr<Job>& job) {
+        lock_guard<mutex> lk(m);
+        pending.erase({ job->cwd, job->args });
+        job->done = true;
+        cv.notify_all();
+    }
+
+    void Wait(const shared_ptr<Job>& job) {
+        unique_lock<mutex> lk(m);
+        cv.wait(lk, [&] { return job->done; });
+    }
+
+    void Stop() {
+        lock_guard<mutex> lk(m);
+        stopping = true;
+        cv.notify_all();
+    }
+};
+
+}
+
+void RunService(const string& socket_path, unsigned int threads, size_t cache_entries, const ServiceJobRunner& run) {
+    sockaddr_un addr = SocketAddress(socket_path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw runtime_error("Cannot create socket: " + string(strerror(errno)));
+    unlink(socket_path.c_str()); // left behind by a service that was killed
+    // Owner-only from the start: umask covers the window before the chmod.
+    mode_t mask = umask(0077);
+    bool bound = bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    umask(mask);
+    if (!bound || chmod(socket_path.c_str(), 0600) != 0 || listen(listener, 64) != 0) {
+        int error = errno;
+        close(listener);
+        throw runtime_error("Cannot listen on " + socket_path + ": " + strerror(error));
+    }
+
+    ThreadPool pool(threads);
+    MatchCache cache(cache_entries);
+    JobQueue jobs;
+    cerr << "Serving on " << socket_path << " with " << pool.Size() << " threads" << endl;
+
+    thread runner([&] {
+        while (auto job = jobs.Next()) {
+            ostringstream out, err;
+            auto* cout_buf = cout.rdbuf(out.rdbuf());
+            auto* cerr_buf = cerr.rdbuf(err.rdbuf());
+            auto start = chrono::steady_clock::now();
+            uint64_t hits = cache.hits, misses = cache.misses;
+            try {
+                filesystem::current_path(job->cwd);
+                job->status = run(job->args, pool, cache);
+            }
+            catch (const exception& e) {
+                cerr << "Error: " << e.what() << endl;
+                job->status = 1;
+            }
+            cout.flush();
+            cout.rdbuf(cout_buf);
+            cerr.rdbuf(cerr_buf);
+            job->out = out.str();
+            job->err = err.str();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cerr << "Job " << job->id << ": status " << job->status << ", " << fixed << setprecision(3) << seconds
+                << " s, " << cache.hits - hits << " cached / " << cache.misses - misses << " played matches, "
+                << cache.Size() << " in cache" << defaultfloat << endl;
+            jobs.Finish(job);
+        }
+    });
+
+    mutex clients_m;
+    condition_variable clients_cv;
+    size_t clients = 0;
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // shut down by --stop
+        }
+        {
+            lock_guard<mutex> lk(clients_m);
+            ++clients;
+        }
+        timeval timeout{ kClientTimeoutSeconds, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        thread([&, fd] {
+            uint32_t count = 0;
+            string cwd;
+            vector<string> args;
+            bool ok = ReadAll(fd, &count, sizeof(count)) && ReadString(fd, cwd);
+            for (uint32_t k = 1; ok && k < count; ++k) {
+                args.emplace_back();
+                ok = ReadString(fd, args.back());
+            }
+            if (ok && !SameUser(fd)) {
+                Reply(fd, 1, "", "Error: the service only takes jobs from the user running it\n");
+            }
+            else if (ok && args.size() == 1 && args[0] == "--stop") {
+                jobs.Stop();
+                shutdown(listener, SHUT_RDWR);
+                Reply(fd, 0, "", "");
+            }
+            else if (ok) {
+                if (auto job = jobs.Submit(cwd, args)) {
+                    jobs.Wait(job);
+                    Reply(fd, job->status, job->out, job->err);
+                }
+                else {
+                    Reply(fd, 1, "", "Error: the service is stopping\n");
+                }
+            }
+            close(fd);
+            lock_guard<mutex> lk(clients_m);
+            --clients;
+            clients_cv.notify_all();
+        }).detach();
+    }
+
+    runner.join();
+    unique_lock<mutex> lk(clients_m);
+    clients_cv.wait(lk, [&] { return clients == 0; });
+    close(listener);
+    unlink(socket_path.c_str());
+}
+
+int RunClient(const string& socket_path, const vector<string>& args) {
+    sockaddr_un addr = SocketAddress(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw runtime_error("Cannot create socket: " + string(strerror(errno)));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int error = errno;
+        close(fd);
+        throw runtime_error("Cannot connect to " + socket_path + ": " + strerror(error));
+    }
+    uint32_t count = static_cast<uint32_t>(args.size() + 1);
+    bool ok = WriteAll(fd, &count, sizeof(count)) && WriteString(fd, filesystem::current_path().string());
+    for (size_t k = 0; ok && k < args.size(); ++k) ok = WriteString(fd, args[k]);
+    int32_t status = 1;
+    string out, err;
+    ok = ok && ReadAll(fd, &status, sizeof(status)) && ReadString(fd, out) && ReadString(fd, err);
+    close(fd);
+    if (!ok) throw runtime_error("Lost the connection to " + socket_path);
+    cout << out << flush;
+    cerr << err << flush;
+    return status;
+}
+
+#endif
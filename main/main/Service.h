@@ -0,0 +1,28 @@
+#pragma once
+#include "common.h"
+#include <functional>
+
+class ThreadPool;
+class MatchCache;
+
+// Runs one job: the arguments of a CLI invocation (without the program name),
+// on the service's shared thread pool and match cache. Results go to cout and
+// cerr as in the CLI; returns the exit status.
+using ServiceJobRunner = std::function<int(const std::vector<std::string>& args, ThreadPool& pool, MatchCache& cache)>;
+
+// Long-running tournament service on a Unix domain socket (--serve). Clients
+// send jobs as CLI arguments plus their working directory; jobs run one at a
+// time in arrival order, each on the whole shared thread pool and from the
+// client's directory, so relative output paths behave as in the CLI. What a job
+// writes to cout and cerr is sent back to its client. A job identical to one
+// still queued or running is not run again: its client gets that job's result.
+// Tournament matches are kept in an LRU MatchCache of cache_entries outcomes
+// shared by all jobs; matches with plugin strategies are not cached. Jobs can
+// load plugins and write anywhere, so the socket is owner-only (0600) and
+// clients of another user are refused. A client sending --stop ends the service
+// once the queue is drained; jobs sent after it are refused.
+void RunService(const std::string& socket_path, unsigned int threads, size_t cache_entries, const ServiceJobRunner& run);
+
+// Sends args to the service at socket_path as one job, copies its output to
+// cout and cerr and returns its exit status.
+int RunClient(const std::string& socket_path, const std::vector<std::string>& args);
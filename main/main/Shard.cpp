@@ -0,0 +1,197 @@
+#include "Shard.h"
+#include "Engine.h"
+#include "Counts.h"
+#include <cstring>
+#include <map>
+
+using namespace std;
+
+namespace {
+
+struct ShardHeader {
+    char magic[8];        // "IPDSHD2"; 2 since MatchSeed mixes the seed on its own
+    uint32_t shard, shards;
+    uint64_t segment_begin, segment_end;
+    uint64_t strategies;
+    uint32_t key_size;
+    uint32_t record_size;
+};
+
+struct ShardRecord {
+    uint64_t count;
+    double mean, m2;
+};
+
+void ReadExactly(FILE* f, void* data, size_t size, const string& path) {
+    if (fread(data, 1, size, f) != size) throw runtime_error("Shard file is truncated: " + path);
+}
+
+string ReadString(FILE* f, size_t size, const string& path) {
+    string s(size, '\0');
+    if (size) ReadExactly(f, &s[0], size, path);
+    return s;
+}
+
+}
+
+pair<uint64_t, uint64_t> ShardSpec::Segments(uint64_t segments) const {
+    if (!Active()) return { 0, segments };
+    return { segments * index / count, segments * (index + 1) / count };
+}
+
+ShardSpec ParseShard(const string& spec) {
+    ShardSpec shard;
+    size_t slash = spec.find('/');
+    try {
+        if (slash == string::npos) throw invalid_argument(spec);
+        shard.index = static_cast<uint32_t>(stoul(spec.substr(0, slash)));
+        shard.count = static_cast<uint32_t>(stoul(spec.substr(slash + 1)));
+    }
+    catch (const exception&) {
+        throw runtime_error("Shard must be k/N: " + spec);
+    }
+    if (shard.count == 0 || shard.index >= shard.count) throw runtime_error("Shard must be k/N with 0 <= k < N: " + spec);
+    return shard;
+}
+
+string ShardPath(const string& output, const ShardSpec& shard) {
+    return output + ".shard-" + to_string(shard.index) + "-of-" + to_string(shard.count);
+}
+
+string ShardKey(const Config& config, const vector<string>& names) {
+    string kernel = config.exact ? "exact" : config.fsm_batch ? "fsm-batch" : "match";
+    char tail[160];
+    snprintf(tail, sizeof(tail), ";payoffs=%.17g/%.17g/%.17g/%.17g;scb=%d", config.payoffs.T_temptation,
+        config.payoffs.R_reward, config.payoffs.P_punishment, config.payoffs.S_sucker, config.apply_scb ? 1 : 0);
+    return CountsCacheKey(names, config.rounds, config.epsilon, NoiseKey(config), config.seed, config.repeats, kernel) + tail;
+}
+
+ShardWriter::ShardWriter(const string& file, const string& key, const vector<string>& names,
+    const ShardSpec& shard, uint64_t segment_begin, uint64_t segment_end) : path(file), temp(file + ".tmp") {
+    f = fopen(temp.c_str(), "wb");
+    if (!f) throw runtime_error("Cannot write shard file: " + temp);
+    ShardHeader header{};
+    memcpy(header.magic, "IPDSHD2", 8);
+    header.shard = shard.index;
+    header.shards = shard.count;
+    header.segment_begin = segment_begin;
+    header.segment_end = segment_end;
+    header.strategies = names.size();
+    header.key_size = static_cast<uint32_t>(key.size());
+    header.record_size = sizeof(ShardRecord);
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(key.data(), 1, key.size(), f);
+    for (const auto& name : names) {
+        uint32_t size = static_cast<uint32_t>(name.size());
+        fwrite(&size, sizeof(size), 1, f);
+        fwrite(name.data(), 1, name.size(), f);
+    }
+}
+
+ShardWriter::~ShardWriter() {
+    if (f) {
+        fclose(f);
+        remove(temp.c_str());
+    }
+}
+
+void ShardWriter::Add(const vector<RunningStats>& segment) {
+    for (const auto& s : segment) {
+        ShardRecord record{ s.count, s.mean, s.m2 };
+        fwrite(&record, sizeof(record), 1, f);
+    }
+}
+
+void ShardWriter::Commit() {
+    bool ok = fflush(f) == 0 && !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    f = nullptr;
+    if (!ok) {
+        remove(temp.c_str());
+        throw runtime_error("Cannot write shard file: " + temp);
+    }
+    remove(path.c_str());
+    if (rename(temp.c_str(), path.c_str()) != 0) throw runtime_error("Cannot write shard file: " + path);
+}
+
+vector<StrategyResult> MergeShards(const vector<string>& paths) {
+    string key;
+    vector<string> names;
+    uint32_t shards = 0;
+    // Shard index -> (path, header), to merge in segment order.
+    map<uint32_t, pair<string, ShardHeader>> found;
+    for (const auto& path : paths) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) throw runtime_error("Cannot read shard file: " + path);
+        ShardHeader header{};
+        string file_key;
+        vector<string> file_names;
+        try {
+            ReadExactly(f, &header, sizeof(header), path);
+            if (memcmp(header.magic, "IPDSHD2", 8) != 0 || header.record_size != sizeof(ShardRecord)) {
+                throw runtime_error("Not a shard file: " + path);
+            }
+            file_key = ReadString(f, header.key_size, path);
+            for (uint64_t k = 0; k < header.strategies; ++k) {
+                uint32_t size = 0;
+                ReadExactly(f, &size, sizeof(size), path);
+                file_names.push_back(ReadString(f, size, path));
+            }
+        }
+        catch (...) {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+        if (found.empty()) {
+            key = file_key;
+            names = file_names;
+            shards = header.shards;
+        }
+        else if (file_key != key || header.shards != shards) {
+            throw runtime_error("Shard file " + path + " belongs to a different run than " + found.begin()->second.first);
+        }
+        if (!found.emplace(header.shard, make_pair(path, header)).second) {
+            throw runtime_error("Shard " + to_string(header.shard) + " given twice: " + found[header.shard].first + " and " + path);
+        }
+    }
+    if (found.size() != shards) {
+        for (uint32_t k = 0; k < shards; ++k) {
+            if (!found.count(k)) throw runtime_error("Shard " + to_string(k) + " of " + to_string(shards) + " is missing");
+        }
+    }
+
+    const size_t n = names.size();
+    vector<RunningStats> stats(n);
+    vector<ShardRecord> records(n);
+    uint64_t next_segment = 0;
+    for (const auto& entry : found) {
+        const string& path = entry.second.first;
+        const ShardHeader& header = entry.second.second;
+        if (header.segment_begin != next_segment) throw runtime_error("Shard file " + path + " does not continue the previous shard");
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) throw runtime_error("Cannot read shard file: " + path);
+        long records_start = static_cast<long>(sizeof(header) + header.key_size);
+        for (const auto& name : names) records_start += static_cast<long>(sizeof(uint32_t) + name.size());
+        fseek(f, records_start, SEEK_SET);
+        try {
+            for (uint64_t s = header.segment_begin; s < header.segment_end; ++s) {
+                ReadExactly(f, records.data(), n * sizeof(ShardRecord), path);
+                for (size_t i = 0; i < n; ++i) stats[i].Merge({ records[i].count, records[i].mean, records[i].m2 });
+            }
+        }
+        catch (...) {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+        next_segment = header.segment_end;
+    }
+
+    vector<StrategyResult> results;
+    for (size_t i = 0; i < n; ++i) {
+        results.push_back(StrategyResult::compute(names[i], stats[i]));
+        results.back().strategy = i;
+    }
+    return results;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "common.h"
+#include <cstdio>
+
+struct Config;
+
+// Sharded tournaments (--shard k/N, --merge). The (rep, i, j) matches of a
+// tournament, in that order, are folded in segments of kFoldSegment: a
+// strategy's statistics are accumulated within each segment and the segments are
+// then merged in order. A single-process run does the same, so shard k of N,
+// which plays and folds only the k-th contiguous run of segments, writes exactly
+// the partial statistics the full run would have merged, and merging every
+// shard in order reproduces the full run's leaderboard bit for bit.
+const uint64_t kFoldSegment = 1 << 16;
+
+struct ShardSpec {
+    uint32_t index = 0, count = 0; // count == 0: not sharded
+
+    bool Active() const { return count > 0; }
+    // Segments [begin, end) of segments belonging to this shard.
+    std::pair<uint64_t, uint64_t> Segments(uint64_t segments) const;
+};
+
+// "k/N" with 0 <= k < N.
+ShardSpec ParseShard(const std::string& spec);
+
+// Where shard k of N of a run with output base `output` is written.
+std::string ShardPath(const std::string& output, const ShardSpec& shard);
+
+// Everything the partial statistics of a tournament depend on.
+std::string ShardKey(const Config& config, const std::vector<std::string>& names);
+
+// One shard's file: a header with the key, shard and segment range and the
+// strategy names, then per segment one RunningStats (count, mean, m2) per
+// strategy. Written to a temporary name and renamed on Commit.
+class ShardWriter {
+private:
+    FILE* f = nullptr;
+    std::string path, temp;
+
+public:
+    ShardWriter(const std::string& file, const std::string& key, const std::vector<std::string>& names,
+        const ShardSpec& shard, uint64_t segment_begin, uint64_t segment_end);
+    ~ShardWriter();
+    ShardWriter(const ShardWriter&) = delete;
+    ShardWriter& operator=(const ShardWriter&) = delete;
+
+    void Add(const std::vector<RunningStats>& segment);
+    void Commit();
+};
+
+// Merges the files of every shard of one run into its leaderboard. Throws when
+// they come from different runs, or a shard is missing or given twice.
+std::vector<StrategyResult> MergeShards(const std::vector<std::string>& paths);
@@ -0,0 +1,381 @@
+#include "Space.h"
+#include "Engine.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Instrument.h"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+// Strategies per side of a tile: a tile's tables and accumulators stay in L1/L2.
+const size_t kSpaceTile = 256;
+
+// The opponent's context for joint state s (the first player's context): both
+// outcomes seen from the other side. Also right for memory one, where s < 4.
+const uint8_t kSwap[4] = { 0, 2, 1, 3 };
+const array<uint8_t, 16> kOpponentContext = [] {
+    array<uint8_t, 16> t{};
+    for (uint32_t s = 0; s < 16; ++s) t[s] = uint8_t(kSwap[s >> 2] << 2 | kSwap[s & 3]);
+    return t;
+}();
+
+// Noise-free match of two deterministic tables. The joint state is the first
+// player's context, so it repeats within 4^memory rounds; the rest of the match
+// is summed from the cycle.
+OutcomeCounts CycleCounts(uint16_t a, uint16_t b, uint32_t mask, int64_t rounds) {
+    int8_t seen[16];
+    uint8_t seq[16];
+    memset(seen, -1, sizeof(seen));
+    uint32_t s = 0;
+    int t = 0;
+    while (seen[s] < 0 && t < rounds) {
+        seen[s] = int8_t(t);
+        uint32_t o = ((a >> s) & 1) << 1 | ((b >> kOpponentContext[s]) & 1);
+        seq[t++] = uint8_t(o);
+        s = ((s << 2) | o) & mask;
+    }
+    int64_t n[4] = {};
+    if (t == rounds) {
+        for (int k = 0; k < t; ++k) n[seq[k]]++;
+    }
+    else {
+        int mu = seen[s], lambda = t - mu;
+        int64_t cycles = (rounds - mu) / lambda, rem = (rounds - mu) % lambda;
+        for (int k = 0; k < mu; ++k) n[seq[k]]++;
+        for (int k = mu; k < t; ++k) n[seq[k]] += cycles + (k - mu < rem);
+    }
+    return { double(n[0]), double(n[1]), double(n[2]), double(n[3]) };
+}
+
+// Expected counts under the joint-state Markov chain, qa / qb being each side's
+// probability of cooperating per context with noise already folded in.
+OutcomeCounts ChainCounts(const double* qa, const double* qb, uint32_t mask, int rounds) {
+    double v[16] = { 1.0 }, next[16], n[4] = {};
+    for (int t = 0; t < rounds; ++t) {
+        fill(next, next + mask + 1, 0.0);
+        for (uint32_t s = 0; s <= mask; ++s) {
+            if (v[s] == 0.0) continue;
+            double ca = qa[s], cb = qb[kOpponentContext[s]];
+            double p[4] = { ca * cb, ca * (1.0 - cb), (1.0 - ca) * cb, (1.0 - ca) * (1.0 - cb) };
+            for (uint32_t o = 0; o < 4; ++o) {
+                double w = v[s] * p[o];
+                n[o] += w;
+                next[((s << 2) | o) & mask] += w;
+            }
+        }
+        copy(next, next + mask + 1, v);
+    }
+    return { n[0], n[1], n[2], n[3] };
+}
+
+template<typename T>
+void Append(vector<uint8_t>& out, const T& value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+// Score pairs as (i's float bits) | (j's float bits) << 32, the on-disk layout.
+uint64_t PackScores(pair<double, double> s) {
+    float a = float(s.first), b = float(s.second);
+    uint32_t x, y;
+    memcpy(&x, &a, 4);
+    memcpy(&y, &b, 4);
+    return uint64_t(x) | uint64_t(y) << 32;
+}
+
+void EncodeTile(const vector<uint64_t>& scores, vector<uint8_t>& out) {
+    unordered_map<uint64_t, uint32_t> index;
+    vector<uint64_t> dictionary;
+    vector<uint16_t> codes(scores.size());
+    bool raw = false;
+    for (size_t k = 0; k < scores.size() && !raw; ++k) {
+        auto it = index.emplace(scores[k], uint32_t(dictionary.size()));
+        if (it.second) dictionary.push_back(scores[k]);
+        raw = dictionary.size() > 65536 || dictionary.size() * 8 >= scores.size() * 6;
+        codes[k] = uint16_t(it.first->second);
+    }
+    uint32_t encoding = raw ? kRawTile : dictionary.size() <= 256 ? kDictionaryTile8 : kDictionaryTile16;
+    Append(out, encoding);
+    Append(out, uint32_t(scores.size()));
+    Append(out, uint32_t(raw ? 0 : dictionary.size()));
+    if (raw) {
+        for (uint64_t s : scores) Append(out, s);
+        return;
+    }
+    for (uint64_t s : dictionary) Append(out, s);
+    for (uint16_t c : codes) {
+        if (encoding == kDictionaryTile8) out.push_back(uint8_t(c));
+        else Append(out, c);
+    }
+}
+
+struct SpaceTile {
+    size_t row = 0, col = 0; // first strategy of the row and column tiles
+    vector<double> row_sum, row_sq, col_sum, col_sq;
+    vector<uint8_t> bytes;
+};
+
+// Streams tiles to a payoff matrix file, see Space.h.
+class PayoffMatrixWriter {
+private:
+    FILE* f = nullptr;
+    string path;
+    uint64_t offset = 0;
+    vector<uint64_t> directory;
+
+    void Write(const void* data, size_t size) {
+        if (fwrite(data, 1, size, f) != size) throw runtime_error("Cannot write payoff matrix: " + path);
+        offset += size;
+    }
+
+public:
+    PayoffMatrixWriter(const string& file, const StrategySpace& space, const Config& config) : path(file) {
+        f = fopen(path.c_str(), "wb");
+        if (!f) throw runtime_error("Cannot write payoff matrix: " + path);
+        vector<uint8_t> header;
+        const char magic[8] = "IPDPAY1";
+        header.insert(header.end(), magic, magic + 8);
+        Append(header, uint64_t(space.Size()));
+        Append(header, uint32_t(kSpaceTile));
+        Append(header, uint32_t(space.memory));
+        Append(header, int32_t(config.rounds));
+        Append(header, uint32_t(0));
+        for (double v : { config.payoffs.T_temptation, config.payoffs.R_reward, config.payoffs.P_punishment,
+                config.payoffs.S_sucker, config.epsilon }) {
+            Append(header, v);
+        }
+        for (const auto& name : space.names) {
+            Append(header, uint32_t(name.size()));
+            header.insert(header.end(), name.begin(), name.end());
+        }
+        Write(header.data(), header.size());
+    }
+    ~PayoffMatrixWriter() {
+        if (f) fclose(f);
+    }
+    PayoffMatrixWriter(const PayoffMatrixWriter&) = delete;
+    PayoffMatrixWriter& operator=(const PayoffMatrixWriter&) = delete;
+
+    void Add(const vector<uint8_t>& tile) {
+        directory.push_back(offset);
+        Write(tile.data(), tile.size());
+    }
+    void Close() {
+        uint64_t start = offset;
+        Write(directory.data(), directory.size() * sizeof(uint64_t));
+        Write(&start, sizeof(start));
+        if (fclose(f) != 0) throw runtime_error("Cannot write payoff matrix: " + path);
+        f = nullptr;
+    }
+};
+
+size_t SpaceCount(const string& spec, size_t prefix) {
+    size_t count = 0;
+    try {
+        count = stoul(spec.substr(prefix));
+    }
+    catch (const exception&) {
+        throw runtime_error("Bad strategy space: " + spec);
+    }
+    if (count == 0) throw runtime_error("Strategy space is empty: " + spec);
+    return count;
+}
+
+void AddMemoryOne(StrategySpace& space, const char* prefix, const array<double, 4>& p) {
+    char name[96];
+    snprintf(name, sizeof(name), "%s%zu:%.2f,%.2f,%.2f,%.2f", prefix, space.Size(), p[0], p[1], p[2], p[3]);
+    space.cooperation.insert(space.cooperation.end(), p.begin(), p.end());
+    space.names.push_back(name);
+}
+
+}
+
+StrategySpace ParseStrategySpace(const string& spec, uint64_t seed) {
+    StrategySpace space;
+    if (spec == "memory1" || spec == "memory2") {
+        space.memory = spec == "memory1" ? 1 : 2;
+        size_t n = size_t(1) << space.Contexts();
+        space.codes.resize(n);
+        space.names.reserve(n);
+        for (size_t code = 0; code < n; ++code) {
+            space.codes[code] = uint16_t(code);
+            char name[16];
+            if (space.memory == 1) {
+                snprintf(name, sizeof(name), "M1:%c%c%c%c", "CD"[code & 1], "CD"[code >> 1 & 1], "CD"[code >> 2 & 1], "CD"[code >> 3 & 1]);
+            }
+            else {
+                snprintf(name, sizeof(name), "M2:%04x", static_cast<unsigned>(code));
+            }
+            space.names.push_back(name);
+        }
+        return space;
+    }
+
+    space.deterministic = false;
+    Rng gen;
+    gen.Seed(seed);
+    if (spec.rfind("stochastic:", 0) == 0) {
+        size_t n = SpaceCount(spec, 11);
+        for (size_t k = 0; k < n; ++k) {
+            array<double, 4> p;
+            for (double& x : p) x = gen.Uniform();
+            AddMemoryOne(space, "S", p);
+        }
+    }
+    else if (spec.rfind("reactive:", 0) == 0) {
+        size_t n = SpaceCount(spec, 9);
+        for (size_t k = 0; k < n; ++k) {
+            double p = gen.Uniform(), q = gen.Uniform();
+            AddMemoryOne(space, "R", { p, q, p, q });
+        }
+    }
+    else if (!spec.empty() && spec[0] == '@') {
+        ifstream in(spec.substr(1));
+        if (!in) throw runtime_error("Cannot read strategy space: " + spec.substr(1));
+        string line;
+        while (getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            replace(line.begin(), line.end(), ',', ' ');
+            istringstream fields(line);
+            array<double, 4> p;
+            if (!(fields >> p[0])) continue;
+            if (!(fields >> p[1] >> p[2] >> p[3])) throw runtime_error("Strategy space line needs four probabilities: " + line);
+            for (double x : p) {
+                if (x < 0.0 || x > 1.0) throw runtime_error("Strategy space probabilities must lie in [0, 1]: " + line);
+            }
+            AddMemoryOne(space, "S", p);
+        }
+        if (space.Size() == 0) throw runtime_error("Strategy space is empty: " + spec);
+    }
+    else {
+        throw runtime_error("Unknown strategy space: " + spec);
+    }
+    return space;
+}
+
+vector<StrategyResult> Engine::RunSpaceTournament(ResultSink* sink) {
+    if (config.noise != "execution" || !config.player_epsilon.empty()) {
+        throw runtime_error("--space supports symmetric execution noise only");
+    }
+    if (config.top_k < 1) throw runtime_error("--top-k must be at least 1");
+    const StrategySpace space = ParseStrategySpace(config.space, config.seed);
+    const size_t n = space.Size(), contexts = space.Contexts();
+    const uint32_t mask = uint32_t(contexts - 1);
+    const int rounds = config.rounds;
+    const double eps = config.epsilon;
+
+    // Noise-free deterministic pairs are walked to their cycle; everything else is
+    // the chain expectation over tables with execution noise folded in.
+    const bool cycles = space.deterministic && eps == 0.0;
+    vector<double> cooperation;
+    if (!cycles) {
+        cooperation.resize(n * contexts);
+        for (size_t k = 0; k < n; ++k) {
+            for (size_t h = 0; h < contexts; ++h) {
+                double q = space.deterministic ? double(!((space.codes[k] >> h) & 1)) : space.cooperation[k * contexts + h];
+                cooperation[k * contexts + h] = q * (1.0 - eps) + (1.0 - q) * eps;
+            }
+        }
+    }
+
+    unique_ptr<PayoffMatrixWriter> matrix;
+    if (!config.payoff_matrix.empty()) matrix = make_unique<PayoffMatrixWriter>(config.payoff_matrix, space, config);
+
+    auto evaluate = [&](SpaceTile& tile) {
+        PhaseScope phase(Phase::Evaluate);
+        size_t row_end = min(n, tile.row + kSpaceTile), col_end = min(n, tile.col + kSpaceTile);
+        tile.row_sum.assign(row_end - tile.row, 0.0);
+        tile.row_sq.assign(row_end - tile.row, 0.0);
+        tile.col_sum.assign(col_end - tile.col, 0.0);
+        tile.col_sq.assign(col_end - tile.col, 0.0);
+        vector<uint64_t> scores;
+        if (matrix) scores.reserve((row_end - tile.row) * (col_end - tile.col));
+        for (size_t i = tile.row; i < row_end; ++i) {
+            double sum = 0.0, sq = 0.0;
+            for (size_t j = max(i, tile.col); j < col_end; ++j) {
+                OutcomeCounts c = cycles ? CycleCounts(space.codes[i], space.codes[j], mask, rounds)
+                    : ChainCounts(&cooperation[i * contexts], &cooperation[j * contexts], mask, rounds);
+                auto s = c.Score(config.payoffs);
+                sum += s.first;
+                sq += s.first * s.first;
+                if (j != i) {
+                    tile.col_sum[j - tile.col] += s.second;
+                    tile.col_sq[j - tile.col] += s.second * s.second;
+                }
+                if (matrix) scores.push_back(PackScores(s));
+            }
+            tile.row_sum[i - tile.row] = sum;
+            tile.row_sq[i - tile.row] = sq;
+        }
+        tile.bytes.clear();
+        if (matrix) EncodeTile(scores, tile.bytes);
+    };
+
+    // Tiles of the upper triangle in file order, evaluated a window at a time and
+    // folded in that order, so the sums do not depend on the thread count.
+    vector<pair<size_t, size_t>> order;
+    const size_t tiles = (n + kSpaceTile - 1) / kSpaceTile;
+    for (size_t b = 0; b < tiles; ++b) {
+        for (size_t c = b; c < tiles; ++c) order.emplace_back(b * kSpaceTile, c * kSpaceTile);
+    }
+    vector<double> sum(n, 0.0), sq(n, 0.0);
+    const size_t window = 4 * (pool ? pool->Size() : 1);
+    vector<SpaceTile> batch;
+    for (size_t start = 0; start < order.size(); start += window) {
+        batch.resize(min(window, order.size() - start));
+        for (size_t k = 0; k < batch.size(); ++k) tie(batch[k].row, batch[k].col) = order[start + k];
+        auto run = [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) evaluate(batch[k]);
+        };
+        if (pool) pool->ParallelFor(batch.size(), 1, run);
+        else run(0, batch.size());
+
+        PhaseScope phase(Phase::Fold);
+        for (const auto& tile : batch) {
+            for (size_t k = 0; k < tile.row_sum.size(); ++k) {
+                sum[tile.row + k] += tile.row_sum[k];
+                sq[tile.row + k] += tile.row_sq[k];
+            }
+            for (size_t k = 0; k < tile.col_sum.size(); ++k) {
+                sum[tile.col + k] += tile.col_sum[k];
+                sq[tile.col + k] += tile.col_sq[k];
+            }
+            if (matrix) matrix->Add(tile.bytes);
+        }
+    }
+    if (matrix) matrix->Close();
+
+    // Each strategy met every strategy once, itself included.
+    vector<size_t> ranking(n);
+    iota(ranking.begin(), ranking.end(), size_t(0));
+    size_t k = min(n, size_t(config.top_k));
+    partial_sort(ranking.begin(), ranking.begin() + k, ranking.end(), [&](size_t a, size_t b) {
+        return sum[a] > sum[b] || (sum[a] == sum[b] && a < b);
+    });
+    vector<StrategyResult> results;
+    for (size_t r = 0; r < k; ++r) {
+        size_t i = ranking[r];
+        StrategyResult res;
+        res.name = space.names[i];
+        res.strategy = i;
+        res.mean_score = sum[i] / n;
+        res.stdev = sqrt(max(0.0, sq[i] / n - res.mean_score * res.mean_score));
+        double se = res.stdev / sqrt(double(n));
+        res.ci_lower = res.mean_score - 1.96 * se;
+        res.ci_upper = res.mean_score + 1.96 * se;
+        results.push_back(res);
+    }
+    if (sink) {
+        sink->Begin(space.names);
+        sink->OnLeaderboard(results);
+        sink->End();
+    }
+    return results;
+}
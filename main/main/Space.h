@@ -0,0 +1,47 @@
+#pragma once
+#include "common.h"
+
+// A whole space of memory-n strategies, generated from a compact encoding instead
+// of one Strategy class each. A strategy is a table indexed by its context: the
+// last n outcomes seen from its own side, oldest in the high bits, each outcome
+// my_move * 2 + opp_move (C = 0, D = 1). Rounds before the first count as mutual
+// cooperation, so the opening move is the one played after CC.
+struct StrategySpace {
+    int memory = 1; // 1 or 2
+    // Deterministic spaces: bit h of codes[k] set means strategy k defects in
+    // context h. Otherwise cooperation[k * Contexts() + h] is its probability of
+    // cooperating there.
+    bool deterministic = true;
+    std::vector<uint16_t> codes;
+    std::vector<double> cooperation;
+    std::vector<std::string> names;
+
+    size_t Size() const { return names.size(); }
+    size_t Contexts() const { return size_t(1) << (2 * memory); }
+};
+
+// The space named by spec:
+//   memory1       all 16 deterministic memory-one strategies, named M1:xxxx after
+//                 their moves following CC, CD, DC and DD (TFT is M1:CDCD)
+//   memory2       all 65536 deterministic memory-two strategies, M2:<code in hex>
+//   stochastic:N  N memory-one strategies (p_CC, p_CD, p_DC, p_DD), uniform on [0, 1]^4
+//   reactive:N    N reactive strategies, cooperating with p after the opponent's C
+//                 and q after its D, (p, q) uniform on [0, 1]^2
+//   @file         one memory-one strategy per line, p_CC,p_CD,p_DC,p_DD
+// Sampled spaces are drawn from seed.
+StrategySpace ParseStrategySpace(const std::string& spec, uint64_t seed);
+
+// Payoff matrix file written by Engine::RunSpaceTournament (all integers little
+// endian). Header: "IPDPAY1\0", uint64 strategies, uint32 tile size, uint32 memory,
+// int32 rounds, uint32 reserved, double T, R, P, S and epsilon, then each name as
+// uint32 length and bytes. Then the tiles of the upper triangle, (b, c) with c >= b
+// in row-major order, each holding the pairs (i, j) of row tile b and column
+// tile c with j >= i, row-major. A tile is uint32 encoding, uint32 entries,
+// uint32 dictionary size, then
+//   kRawTile          entries x (float i's score, float j's score)
+//   kDictionaryTile8  dictionary of score pairs as above, entries x uint8 index
+//   kDictionaryTile16 the same with uint16 indices
+// Deterministic noise-free spaces have few distinct outcomes per tile, so their
+// tiles are dictionary coded. The file ends with a uint64 offset per tile and the
+// uint64 offset of that directory.
+enum PayoffTileEncoding : uint32_t { kRawTile = 0, kDictionaryTile8 = 1, kDictionaryTile16 = 2 };
@@ -0,0 +1,166 @@
+#include "Engine.h"
+#include "Graph.h"
+#include "ThreadPool.h"
+#include "Output.h"
+#include "Instrument.h"
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+const uint64_t kSpatialMatchStream = 0x535041544D41ULL;
+const uint64_t kSpatialUpdateStream = 0x535041545550ULL;
+
+// Nodes per parallel chunk. Lattice nodes are numbered row-major and loaded
+// graphs in breadth-first order, so a chunk is a tile of nearby nodes.
+const size_t kNodeGrain = 4096;
+
+// splitmix64 stream for the per-node update decisions, seeded from
+// (generation, node) so the outcome does not depend on the thread that runs it.
+struct NodeRandom {
+    uint64_t state;
+
+    uint64_t Next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    double Uniform() { return static_cast<double>(Next() >> 11) * 0x1.0p-53; }
+    size_t Below(size_t n) { return static_cast<size_t>(Uniform() * n); }
+};
+
+Graph SpatialGraph(const Config& config) {
+    if (!config.graph.empty()) return LoadEdgeList(config.graph);
+    istringstream in(config.lattice);
+    uint32_t width = 0, height = 0;
+    char x = 0;
+    if (!(in >> width >> x >> height) || (x != 'x' && x != 'X')) {
+        throw runtime_error("Lattice must be given as WxH: " + config.lattice);
+    }
+    return LatticeGraph(width, height, config.moore);
+}
+
+}
+
+vector<vector<StrategyResult>> Engine::RunSpatialEvolution(ResultSink* sink) {
+    Graph graph = SpatialGraph(config);
+    const size_t n = strategy_pool.size();
+    const size_t nodes = graph.Nodes();
+    vector<vector<StrategyResult>> evolution_history;
+    if (sink) sink->Begin(names);
+
+    auto parallel = [&](auto&& body) {
+        if (pool) pool->ParallelFor(nodes, kNodeGrain, body);
+        else body(size_t(0), nodes);
+    };
+
+    vector<double> scb_cost(n, 0.0);
+    if (config.apply_scb) {
+        for (size_t i = 0; i < n; ++i) scb_cost[i] = GetSCB_Cost(names[i]);
+    }
+
+    // Fill the pair cache up front so the parallel edge pass only reads it.
+    vector<pair<size_t, size_t>> cacheable;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            if (PairCacheable(i, j)) cacheable.emplace_back(i, j);
+        }
+    }
+    auto warm = [&](size_t begin, size_t end) {
+        auto& players = SlotPlayers();
+        for (size_t k = begin; k < end; ++k) PlayPair(players, cacheable[k].first, cacheable[k].second, 0);
+    };
+    if (pool) pool->ParallelFor(cacheable.size(), 1, warm);
+    else warm(0, cacheable.size());
+
+    mt19937 evo_rng(config.seed);
+    uniform_int_distribution<uint32_t> any_type(0, static_cast<uint32_t>(n - 1));
+    vector<uint32_t> type(nodes), next_type(nodes);
+    for (auto& t : type) t = any_type(evo_rng);
+
+    // changed[u]: node u switched strategy in the last update, so its pairs are replayed.
+    vector<char> changed(nodes, 1), next_changed(nodes);
+    vector<double> edge_score(graph.neighbours.size(), 0.0), payoff(nodes, 0.0);
+
+    for (int gen = 0; gen < config.generations; ++gen) {
+        {
+            PhaseScope evaluate(Phase::Evaluate);
+            // Each pair is played by its lower-numbered node, which writes both sides.
+            parallel([&](size_t begin, size_t end) {
+                auto& players = SlotPlayers();
+                for (size_t u = begin; u < end; ++u) {
+                    for (uint64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                        uint32_t v = graph.neighbours[e];
+                        if (v < u || !(changed[u] || changed[v])) continue;
+                        PairTimer timer(type[u], type[v], config.rounds);
+                        auto scores = PlayPair(players, type[u], type[v], MatchSeed(config.seed ^ kSpatialMatchStream, gen, u, v));
+                        edge_score[e] = scores.first;
+                        edge_score[graph.reverse[e]] = scores.second;
+                    }
+                }
+            });
+            parallel([&](size_t begin, size_t end) {
+                for (size_t u = begin; u < end; ++u) {
+                    double total = -scb_cost[type[u]];
+                    for (uint64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) total += edge_score[e];
+                    payoff[u] = total;
+                }
+            });
+        }
+
+        vector<int> count(n, 0);
+        vector<double> score(n, 0.0);
+        for (size_t u = 0; u < nodes; ++u) {
+            count[type[u]]++;
+            score[type[u]] += payoff[u];
+        }
+        vector<StrategyResult> gen_results;
+        for (size_t i = 0; i < n; ++i) {
+            if (count[i] == 0) continue;
+            StrategyResult res;
+            res.name = names[i];
+            res.strategy = i;
+            res.population = count[i];
+            res.mean_score = score[i] / count[i];
+            gen_results.push_back(res);
+        }
+        if (sink) sink->OnGeneration(gen, gen_results);
+        else evolution_history.push_back(gen_results);
+
+        // Synchronous update: every node reads the old generation and writes the
+        // next one, so nodes can be updated in any order and in parallel.
+        const bool fermi = config.update == "fermi";
+        PhaseScope update(Phase::SpatialUpdate);
+        parallel([&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                NodeRandom r{ MatchSeed(config.seed ^ kSpatialUpdateStream, gen, u, 0) };
+                uint32_t chosen = type[u];
+                if (!fermi) {
+                    double best = payoff[u];
+                    for (uint64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                        uint32_t v = graph.neighbours[e];
+                        if (payoff[v] > best) {
+                            best = payoff[v];
+                            chosen = type[v];
+                        }
+                    }
+                }
+                else if (graph.Degree(u) > 0) {
+                    uint32_t v = graph.neighbours[graph.offsets[u] + r.Below(graph.Degree(u))];
+                    double adopt = 1.0 / (1.0 + exp((payoff[u] - payoff[v]) / config.temperature));
+                    if (r.Uniform() < adopt) chosen = type[v];
+                }
+                if (r.Uniform() < config.mutation) chosen = static_cast<uint32_t>(r.Below(n));
+                next_type[u] = chosen;
+                next_changed[u] = chosen != type[u];
+            }
+        });
+        type.swap(next_type);
+        changed.swap(next_changed);
+    }
+    if (sink) sink->End();
+    return evolution_history;
+}
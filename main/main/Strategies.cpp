@@ -1,158 +1,101 @@
-#include "Strategy.h"
+#include "Strategies.h"
 #include <sstream>
 #include <stdexcept>
 #include <cctype>
 #include <algorithm>
+#include <unordered_map>
 
 using namespace std;
 
-mt19937 rng(random_device{}());
+thread_local Rng rng(random_device{}());
 void set_global_seed(unsigned int seed) {
-    rng.seed(seed);
+    rng.Seed(seed);
 }
 
 
-class ALLC : public Strategy {
-public:
-    Move decide(const History&, const History&) override { return Move::C; }
-    string name() const override { return "ALLC"; }
-};
+namespace {
 
-class ALLD : public Strategy {
-public:
-    Move decide(const History&, const History&) override { return Move::D; }
-    string name() const override { return "ALLD"; }
-};
+string Upper(string name) {
+    transform(name.begin(), name.end(), name.begin(), ::toupper);
+    return name;
+}
 
-class TFT : public Strategy {
-public:
-    Move decide(const History&, const History& opp_history) override {
-        if (opp_history.empty()) return Move::C;
-        return opp_history.back();
-    }
-    string name() const override { return "TFT"; }
-};
+const unordered_map<string, BuiltinStrategy>& Builtins() {
+    static const unordered_map<string, BuiltinStrategy> builtins = {
+        { "ALLC", ALLC() }, { "ALLD", ALLD() }, { "TFT", TFT() }, { "GRIM", GRIM() },
+        { "PAVLOV", PAVLOV() }, { "CONTRITE", CTFT() }, { "PROBER", PROBER() },
+        { "SUS_TFT", SuspiciousTFT() }, { "ALTERNATE", ALTERNATE() }, { "RND", RND() },
+    };
+    return builtins;
+}
 
-class GRIM : public Strategy {
-    bool triggered = false;
-public:
-    void reset() override { triggered = false; }
-    Move decide(const History&, const History& opp_history) override {
-        if (triggered) return Move::D;
-        if (!opp_history.empty() && opp_history.back() == Move::D) {
-            triggered = true;
-            return Move::D;
+// Keyed by upper-case name.
+unordered_map<string, StrategyFactory>& Registry() {
+    static unordered_map<string, StrategyFactory> registry = [] {
+        unordered_map<string, StrategyFactory> builtins;
+        for (const auto& kv : Builtins()) {
+            BuiltinStrategy prototype = kv.second;
+            builtins[kv.first] = [prototype]() {
+                return visit([](const auto& s) -> unique_ptr<Strategy> {
+                    return make_unique<decay_t<decltype(s)>>(s);
+                    }, prototype);
+            };
         }
-        return Move::C;
-    }
-    string name() const override { return "GRIM"; }
-};
+        return builtins;
+    }();
+    return registry;
+}
 
-class PAVLOV : public Strategy {
-public:
-    Move decide(const History& self_history, const History& opp_history) override {
-        if (self_history.empty()) return Move::C;
-        Move my_last = self_history.back();
-        Move opp_last = opp_history.back();
-        bool was_successful = (my_last == Move::C && opp_last == Move::C) || (my_last == Move::D && opp_last == Move::C);
-        if (was_successful) return my_last;
-        return my_last == Move::C ? Move::D : Move::C;
-    }
-    string name() const override { return "PAVLOV"; }
-};
+// The default clone_into: owns a fresh registry instance of a strategy without
+// the prototype API and plays it, so that the instance can live in an arena.
+class RegistryClone : public Strategy {
+private:
+    unique_ptr<Strategy> instance;
 
-class RND : public Strategy {
 public:
-    Move decide(const History&, const History&) override {
-        uniform_real_distribution<double> dist(0.0, 1.0);
-             return dist(rng) < 0.5 ? Move::C : Move::D;
-    }
-    string name() const override {
-        // The name is now just "RND"
-        return "RND";
-    }
+    explicit RegistryClone(unique_ptr<Strategy> s) : instance(move(s)) {}
+    Move decide(const History& self_history, const History& opp_history) override { return instance->decide(self_history, opp_history); }
+    string name() const override { return instance->name(); }
+    void reset() override { instance->reset(); }
+    bool is_deterministic() const override { return instance->is_deterministic(); }
+    unique_ptr<Strategy> clone() const override { return instance->clone(); }
+    Strategy* clone_into(pmr::memory_resource& arena) const override { return instance->clone_into(arena); }
 };
 
-class CTFT : public Strategy {
-public:
-    Move decide(const History& self_history, const History& opp_history) override {
-        if (self_history.empty()) return Move::C;
-        if (self_history.size() >= 2) {
-            if (self_history[self_history.size() - 2] == Move::C && self_history.back() == Move::D && opp_history.back() == Move::D) {
-                return Move::C;
-            }
-        }
-        return opp_history.back();
-    }
-    string name() const override { return "CONTRITE"; }
-};
+}
 
-class PROBER : public Strategy {
-    bool opponent_is_exploitable = false;
-    bool probe_phase_complete = false;
-public:
-    void reset() override {
-        opponent_is_exploitable = false;
-        probe_phase_complete = false;
-    }
-    Move decide(const History& self_history, const History& opp_history) override {
-        size_t round = self_history.size();
-        if (round == 0) return Move::C;
-        if (round == 1) return Move::D;
-        if (round == 2) return Move::C;
-        if (round == 3) return Move::C;
-
-        if (!probe_phase_complete) {
-            probe_phase_complete = true;
-            if (opp_history[1] == Move::C && opp_history[2] == Move::C&& opp_history[3] == Move::C) {
-                opponent_is_exploitable = true;
-            }
-        }
+optional<BuiltinStrategy> CreateBuiltin(const string& name) {
+    const auto& builtins = Builtins();
+    auto it = builtins.find(name);
+    if (it == builtins.end()) it = builtins.find(Upper(name));
+    if (it == builtins.end()) return nullopt;
+    return it->second;
+}
 
-        if (opponent_is_exploitable) return Move::D;
-        return opp_history.back();
-    }
-    string name() const override { return "PROBER"; }
-};
+void RegisterStrategy(const string& name, StrategyFactory factory) {
+    if (!Registry().emplace(Upper(name), move(factory)).second) throw runtime_error("Strategy " + name + " is already registered");
+}
 
-// Own Statergy 1 - It starts by playing Defect (D),It plays exactly like standard TFT, copying whatever the opponent did on the previous move.
-class SuspiciousTFT : public Strategy {
-public:
-    Move decide(const History&, const History& opp_history) override {
-        if (opp_history.empty()) return Move::D;
-        return opp_history.back();
-    }
-    string name() const override { return "SUS_TFT"; }
-};
+bool IsRegisteredStrategy(const string& name) {
+    return Registry().count(Upper(name)) != 0;
+}
 
-// Own Statergy 2 - Cooperate on even rounds, Defect on odd rounds
-class ALTERNATE : public Strategy {
-public:
-    Move decide(const History& self_history, const History&) override {
-        if (self_history.size() % 2 == 0) {
-            return Move::C;
-        }
-        else {
-            return Move::D;
-        }
-    }
-    string name() const override { return "ALTERNATE"; }
-};
+unique_ptr<Strategy> CreateStrategy(const string& name) {
+    const auto& registry = Registry();
+    auto it = registry.find(name);
+    if (it == registry.end()) it = registry.find(Upper(name));
+    if (it == registry.end()) throw runtime_error("Unknown strategy: " + name);
+    return it->second();
+}
 
+unique_ptr<Strategy> Strategy::clone() const {
+    if (!IsRegisteredStrategy(name())) {
+        throw runtime_error("Strategy " + name() + " cannot be cloned: register it, derive its class from CloneableStrategy<> or override clone and clone_into");
+    }
+    return CreateStrategy(name());
+}
 
-unique_ptr<Strategy> CreateStrategy(const string& name) {
-    string upper_name = name;
-    transform(upper_name.begin(), upper_name.end(), upper_name.begin(), ::toupper);
-
-    if (upper_name == "ALLC") return make_unique<ALLC>();
-    if (upper_name == "ALLD") return make_unique<ALLD>();
-    if (upper_name == "TFT") return make_unique<TFT>();
-    if (upper_name == "GRIM") return make_unique<GRIM>();
-    if (upper_name == "PAVLOV") return make_unique<PAVLOV>();
-    if (upper_name == "CONTRITE") return make_unique<CTFT>();
-    if (upper_name == "PROBER") return make_unique<PROBER>();
-    if (upper_name == "SUS_TFT") return make_unique<SuspiciousTFT>();
-    if (upper_name == "ALTERNATE") return make_unique<ALTERNATE>();
-    if (upper_name == "RND") return make_unique<RND>();
-    throw runtime_error("Unknown strategy: " + name);
-}
\ No newline at end of file
+Strategy* Strategy::clone_into(pmr::memory_resource& arena) const {
+    auto instance = clone();
+    return new (arena.allocate(sizeof(RegistryClone), alignof(RegistryClone))) RegistryClone(move(instance));
+}
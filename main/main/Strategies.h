@@ -2,17 +2,151 @@
 // Strategies.h
 #pragma once
 #include "Strategy.h"
+#include <optional>
+#include <variant>
+
+// The built-in strategies are final so calls through a concrete type are devirtualized.
 
 // Standard Strategies
-class ALLC : public Strategy { /* ... */ };
-class ALLD : public Strategy { /* ... */ };
-class TFT : public Strategy { /* ... */ };
-class GRIM : public Strategy { /* ... */ };
-class PAVLOV : public Strategy { /* ... */ };
-class RND : public Strategy { /* ... */ };
-class CTFT : public Strategy { /* ... */ };
-class PROBER : public Strategy { /* ... */ };
+class ALLC final : public CloneableStrategy<ALLC> {
+public:
+    Move decide(const History&, const History&) override { return Move::C; }
+    string name() const override { return "ALLC"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class ALLD final : public CloneableStrategy<ALLD> {
+public:
+    Move decide(const History&, const History&) override { return Move::D; }
+    string name() const override { return "ALLD"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class TFT final : public CloneableStrategy<TFT> {
+public:
+    Move decide(const History&, const History& opp_history) override {
+        if (opp_history.empty()) return Move::C;
+        return opp_history.back();
+    }
+    string name() const override { return "TFT"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class GRIM final : public CloneableStrategy<GRIM> {
+    bool triggered = false;
+public:
+    void reset() override { triggered = false; }
+    Move decide(const History&, const History& opp_history) override {
+        if (triggered) return Move::D;
+        if (!opp_history.empty() && opp_history.back() == Move::D) {
+            triggered = true;
+            return Move::D;
+        }
+        return Move::C;
+    }
+    string name() const override { return "GRIM"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class PAVLOV final : public CloneableStrategy<PAVLOV> {
+public:
+    Move decide(const History& self_history, const History& opp_history) override {
+        if (self_history.empty()) return Move::C;
+        Move my_last = self_history.back();
+        Move opp_last = opp_history.back();
+        bool was_successful = (my_last == Move::C && opp_last == Move::C) || (my_last == Move::D && opp_last == Move::C);
+        if (was_successful) return my_last;
+        return my_last == Move::C ? Move::D : Move::C;
+    }
+    string name() const override { return "PAVLOV"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class RND final : public CloneableStrategy<RND> {
+public:
+    Move decide(const History&, const History&) override {
+        return (rng() >> 63) ? Move::D : Move::C;
+    }
+    string name() const override {
+        // The name is now just "RND"
+        return "RND";
+    }
+};
+
+class CTFT final : public CloneableStrategy<CTFT> {
+public:
+    Move decide(const History& self_history, const History& opp_history) override {
+        if (self_history.empty()) return Move::C;
+        if (self_history.size() >= 2) {
+            if (self_history[self_history.size() - 2] == Move::C && self_history.back() == Move::D && opp_history.back() == Move::D) {
+                return Move::C;
+            }
+        }
+        return opp_history.back();
+    }
+    string name() const override { return "CONTRITE"; }
+    bool is_deterministic() const override { return true; }
+};
+
+class PROBER final : public CloneableStrategy<PROBER> {
+    bool opponent_is_exploitable = false;
+    bool probe_phase_complete = false;
+public:
+    void reset() override {
+        opponent_is_exploitable = false;
+        probe_phase_complete = false;
+    }
+    Move decide(const History& self_history, const History& opp_history) override {
+        size_t round = self_history.size();
+        if (round == 0) return Move::C;
+        if (round == 1) return Move::D;
+        if (round == 2) return Move::C;
+        if (round == 3) return Move::C;
+
+        if (!probe_phase_complete) {
+            probe_phase_complete = true;
+            if (opp_history[1] == Move::C && opp_history[2] == Move::C&& opp_history[3] == Move::C) {
+                opponent_is_exploitable = true;
+            }
+        }
+
+        if (opponent_is_exploitable) return Move::D;
+        return opp_history.back();
+    }
+    string name() const override { return "PROBER"; }
+    bool is_deterministic() const override { return true; }
+};
 
 // Two Original Strategies
-class SuspiciousTFT : public Strategy { /* ... */ };
-class ALTERNATE : public Strategy { /* ... */ };
\ No newline at end of file
+
+// Own Statergy 1 - It starts by playing Defect (D),It plays exactly like standard TFT, copying whatever the opponent did on the previous move.
+class SuspiciousTFT final : public CloneableStrategy<SuspiciousTFT> {
+public:
+    Move decide(const History&, const History& opp_history) override {
+        if (opp_history.empty()) return Move::D;
+        return opp_history.back();
+    }
+    string name() const override { return "SUS_TFT"; }
+    bool is_deterministic() const override { return true; }
+};
+
+// Own Statergy 2 - Cooperate on even rounds, Defect on odd rounds
+class ALTERNATE final : public CloneableStrategy<ALTERNATE> {
+public:
+    Move decide(const History& self_history, const History&) override {
+        if (self_history.size() % 2 == 0) {
+            return Move::C;
+        }
+        else {
+            return Move::D;
+        }
+    }
+    string name() const override { return "ALTERNATE"; }
+    bool is_deterministic() const override { return true; }
+};
+
+// Value-type handle over every built-in, used by the statically dispatched match kernels.
+using BuiltinStrategy = std::variant<ALLC, ALLD, TFT, GRIM, PAVLOV, RND, CTFT, PROBER, SuspiciousTFT, ALTERNATE>;
+
+// Returns the built-in registered under name (case-insensitive), or nullopt.
+std::optional<BuiltinStrategy> CreateBuiltin(const std::string& name);
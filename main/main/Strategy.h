@@ -1,13 +1,17 @@
 #pragma once
 #include "common.h"
+#include "History.h"
 #include <string>
 #include <vector>
+#include <functional>
 #include <memory>
+#include <memory_resource>
 #include <random>
 
 using namespace std;
 
-using History = vector<Move>;
+// Strategies receive lightweight views of the packed histories.
+using History = HistoryView;
 
 class Strategy {
 public:
@@ -15,6 +19,41 @@ public:
     virtual Move decide(const History& self_history, const History& opp_history) = 0;
     virtual string name() const = 0;
     virtual void reset() {}
+    // True when decide() depends only on the histories (no RNG), so a noise-free
+    // match between two such strategies always ends with the same scores.
+    virtual bool is_deterministic() const { return false; }
+
+    // Prototype API: a new instance in the same state. clone_into constructs it
+    // in memory from arena; it is then destroyed with ~Strategy() and never deleted.
+    // The Engine clones every player; strategies usually implement both by deriving
+    // from CloneableStrategy<Derived> instead of Strategy. The defaults, for older
+    // subclasses, create a fresh instance of the registered strategy name() instead,
+    // so no state is copied; they throw when name() is not registered.
+    virtual unique_ptr<Strategy> clone() const;
+    virtual Strategy* clone_into(pmr::memory_resource& arena) const;
+};
+
+// Implements the prototype API for a copyable strategy type.
+template<typename Derived>
+class CloneableStrategy : public Strategy {
+public:
+    unique_ptr<Strategy> clone() const override { return make_unique<Derived>(static_cast<const Derived&>(*this)); }
+    Strategy* clone_into(pmr::memory_resource& arena) const override {
+        return new (arena.allocate(sizeof(Derived), alignof(Derived))) Derived(static_cast<const Derived&>(*this));
+    }
 };
 
+using StrategyFactory = function<unique_ptr<Strategy>()>;
+
+// Adds a strategy CreateStrategy can build. Names are case-insensitive and must
+// be new: overriding a built-in would leave --fast-path, --fsm-batch and --exact
+// playing the built-in. Register before matches start; lookups from running
+// matches are not locked.
+void RegisterStrategy(const string& name, StrategyFactory factory);
+
+// True when RegisterStrategy already has the name (case-insensitively).
+bool IsRegisteredStrategy(const string& name);
+
+// Hash lookup of a registered strategy (the built-ins, and those of loaded
+// plugins): the exact name first, then case-insensitively.
 unique_ptr<Strategy> CreateStrategy(const string& name);
\ No newline at end of file
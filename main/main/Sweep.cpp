@@ -0,0 +1,149 @@
+#include "Engine.h"
+#include "Output.h"
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+string Trim(const string& s) {
+    size_t first = s.find_first_not_of(" \t\r"), last = s.find_last_not_of(" \t\r");
+    return first == string::npos ? string() : s.substr(first, last - first + 1);
+}
+
+// Splits on any of the separators, trimming and dropping empty tokens.
+vector<string> Tokens(const string& s, const string& separators) {
+    vector<string> tokens;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find_first_of(separators, start);
+        if (end == string::npos) end = s.size();
+        string token = Trim(s.substr(start, end - start));
+        if (!token.empty()) tokens.push_back(token);
+        start = end + 1;
+    }
+    return tokens;
+}
+
+// "a,b,c" and/or "start:stop:step" items, stop included.
+vector<double> NumberAxis(const string& axis, const string& values) {
+    vector<double> out;
+    for (const auto& item : Tokens(values, ",")) {
+        auto parts = Tokens(item, ":");
+        if (parts.size() == 1) {
+            out.push_back(stod(parts[0]));
+        }
+        else if (parts.size() == 3) {
+            double start = stod(parts[0]), stop = stod(parts[1]), step = stod(parts[2]);
+            if (!(step > 0.0) || stop < start) throw runtime_error("Bad range for sweep axis " + axis + ": " + item);
+            long long count = static_cast<long long>(floor((stop - start) / step + 1e-9)) + 1;
+            for (long long k = 0; k < count; ++k) out.push_back(start + k * step);
+        }
+        else {
+            throw runtime_error("Bad value for sweep axis " + axis + ": " + item);
+        }
+    }
+    if (out.empty()) throw runtime_error("Sweep axis " + axis + " has no values");
+    return out;
+}
+
+}
+
+vector<SweepPoint> ParseSweepGrid(const string& spec, const Config& base) {
+    string text = spec;
+    if (!spec.empty() && spec[0] == '@') {
+        ifstream in(spec.substr(1));
+        if (!in) throw runtime_error("Cannot open sweep file: " + spec.substr(1));
+        stringstream buffer;
+        buffer << in.rdbuf();
+        text = buffer.str();
+    }
+
+    vector<int> rounds{ base.rounds };
+    vector<double> epsilon{ base.epsilon };
+    vector<PayoffMatrix<double>> payoffs{ base.payoffs };
+    for (const auto& axis : Tokens(text, ";\n")) {
+        if (axis[0] == '#') continue;
+        size_t eq = axis.find('=');
+        if (eq == string::npos) throw runtime_error("Sweep axis must be name=values: " + axis);
+        string name = Trim(axis.substr(0, eq));
+        string values = axis.substr(eq + 1);
+
+        if (name == "rounds") {
+            rounds.clear();
+            for (double v : NumberAxis(name, values)) {
+                if (v < 1.0) throw runtime_error("Sweep rounds must be positive");
+                rounds.push_back(static_cast<int>(llround(v)));
+            }
+        }
+        else if (name == "epsilon") {
+            epsilon = NumberAxis(name, values);
+            for (double v : epsilon) {
+                if (v < 0.0 || v > 1.0) throw runtime_error("Sweep epsilon must lie in [0, 1]");
+            }
+        }
+        else if (name == "payoffs") {
+            payoffs.clear();
+            for (const auto& item : Tokens(values, ",")) {
+                auto p = Tokens(item, "/");
+                if (p.size() != 4) throw runtime_error("Sweep payoffs must be T/R/P/S: " + item);
+                PayoffMatrix<double> m;
+                m.T_temptation = stod(p[0]);
+                m.R_reward = stod(p[1]);
+                m.P_punishment = stod(p[2]);
+                m.S_sucker = stod(p[3]);
+                m.Validate();
+                payoffs.push_back(m);
+            }
+            if (payoffs.empty()) throw runtime_error("Sweep axis payoffs has no values");
+        }
+        else {
+            throw runtime_error("Unknown sweep axis: " + name);
+        }
+    }
+
+    vector<SweepPoint> points;
+    for (int r : rounds) {
+        for (double e : epsilon) {
+            for (const auto& p : payoffs) points.push_back({ r, e, p });
+        }
+    }
+    return points;
+}
+
+vector<vector<StrategyResult>> Engine::RunSweep(const vector<SweepPoint>& points, ResultSink* sink) {
+    const int saved_rounds = config.rounds;
+    const double saved_epsilon = config.epsilon;
+    vector<vector<StrategyResult>> results(points.size());
+    vector<bool> done(points.size(), false);
+
+    for (size_t p = 0; p < points.size(); ++p) {
+        if (done[p]) continue;
+        vector<size_t> group;
+        vector<PayoffMatrix<double>> payoff_sets;
+        for (size_t q = p; q < points.size(); ++q) {
+            if (!done[q] && points[q].rounds == points[p].rounds && points[q].epsilon == points[p].epsilon) {
+                group.push_back(q);
+                payoff_sets.push_back(points[q].payoffs);
+                done[q] = true;
+            }
+        }
+        config.rounds = points[p].rounds;
+        config.epsilon = points[p].epsilon;
+        auto group_results = Tournament(payoff_sets, nullptr);
+        for (size_t k = 0; k < group.size(); ++k) results[group[k]] = move(group_results[k]);
+    }
+
+    config.rounds = saved_rounds;
+    config.epsilon = saved_epsilon;
+
+    if (sink) {
+        sink->Begin(names);
+        for (size_t p = 0; p < points.size(); ++p) {
+            sink->OnSweepPoint(p, points[p].rounds, points[p].epsilon, points[p].payoffs, results[p]);
+        }
+        sink->End();
+    }
+    return results;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every slot owns a deque: the owner pushes and pops at
+// the back, idle slots steal from the front of the others. Slot 0 belongs to the
+// external thread that calls ParallelFor, slots 1..Size()-1 to background workers.
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<size_t> next_queue{ 0 };
+    std::mutex sleep_m;
+    std::condition_variable wake;
+    bool stop = false;
+
+    static int& Slot() {
+        static thread_local int slot = -1;
+        return slot;
+    }
+
+    bool Pop(size_t q, bool back, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lk(queues[q]->m);
+        auto& tasks = queues[q]->tasks;
+        if (tasks.empty()) return false;
+        if (back) { task = std::move(tasks.back()); tasks.pop_back(); }
+        else { task = std::move(tasks.front()); tasks.pop_front(); }
+        queued--;
+        return true;
+    }
+
+    bool TryRunOne(size_t self) {
+        std::function<void()> task;
+        bool found = Pop(self, true, task);
+        for (size_t k = 1; !found && k < queues.size(); ++k) {
+            found = Pop((self + k) % queues.size(), false, task);
+        }
+        if (found) task();
+        return found;
+    }
+
+    void WorkerLoop(size_t self) {
+        Slot() = static_cast<int>(self);
+        for (;;) {
+            if (TryRunOne(self)) continue;
+            std::unique_lock<std::mutex> lk(sleep_m);
+            wake.wait(lk, [&] { return stop || queued > 0; });
+            if (stop) return;
+        }
+    }
+
+public:
+    // threads == 0 uses every hardware thread.
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+        for (unsigned i = 1; i < threads; ++i) workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(sleep_m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const { return queues.size(); }
+
+    // Slot of the calling thread: a worker's own index, 0 for any other thread.
+    static size_t CurrentSlot() { return Slot() < 0 ? 0 : static_cast<size_t>(Slot()); }
+
+    void Submit(std::function<void()> task) {
+        size_t q = Slot() >= 0 ? static_cast<size_t>(Slot()) : next_queue++ % queues.size();
+        queued++;
+        {
+            std::lock_guard<std::mutex> lk(queues[q]->m);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        { std::lock_guard<std::mutex> lk(sleep_m); }
+        wake.notify_one();
+    }
+
+    // Calls body(begin, end) over [0, count) in chunks of at most grain items and
+    // returns once every chunk has run. The calling thread helps drain the queues,
+    // so nested calls from inside a task cannot deadlock.
+    template<typename Body>
+    void ParallelFor(size_t count, size_t grain, Body&& body) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+        if (queues.size() == 1 || count <= grain) {
+            body(size_t(0), count);
+            return;
+        }
+
+        size_t chunks = (count + grain - 1) / grain;
+        std::atomic<size_t> remaining{ chunks };
+        std::exception_ptr error;
+        std::mutex error_m;
+
+        bool external = Slot() < 0;
+        if (external) Slot() = 0;
+        size_t self = CurrentSlot();
+
+        queued += chunks;
+        // Deal chunks round-robin so every worker starts with local work.
+        for (size_t c = 0; c < chunks; ++c) {
+            size_t begin = c * grain, end = std::min(count, begin + grain);
+            size_t q = (self + c) % queues.size();
+            std::lock_guard<std::mutex> lk(queues[q]->m);
+            queues[q]->tasks.push_back([&, begin, end] {
+                try { body(begin, end); }
+                catch (...) {
+                    std::lock_guard<std::mutex> elk(error_m);
+                    if (!error) error = std::current_exception();
+                }
+                remaining--;
+            });
+        }
+        { std::lock_guard<std::mutex> lk(sleep_m); }
+        wake.notify_all();
+
+        while (remaining > 0) {
+            if (!TryRunOne(self)) std::this_thread::yield();
+        }
+        if (external) Slot() = -1;
+        if (error) std::rethrow_exception(error);
+    }
+};
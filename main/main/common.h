@@ -10,7 +10,10 @@
 #include <cmath>
 #include <numeric>
 #include <iomanip>
+#include <algorithm>
 #include <random>
+#include <cstdint>
+#include "Random.h"
 
 
 enum class Move { C, D };
@@ -40,8 +43,64 @@ struct PayoffMatrix {
     }
 };
 
+// Rounds of a match by joint outcome, from the first player's side (cd: the first
+// player cooperated, the second defected); expected values in exact mode. Scores are
+// linear in these counts, so one match can be scored under any payoff matrix.
+struct OutcomeCounts {
+    double cc = 0.0, cd = 0.0, dc = 0.0, dd = 0.0;
+
+    template<typename T>
+    std::pair<double, double> Score(const PayoffMatrix<T>& p) const {
+        return { cc * p.R_reward + cd * p.S_sucker + dc * p.T_temptation + dd * p.P_punishment,
+                 cc * p.R_reward + cd * p.T_temptation + dc * p.S_sucker + dd * p.P_punishment };
+    }
+};
+
+// How a match's moves are corrupted. Execution noise flips the move a player
+// makes; perception noise leaves the move alone and flips what a player sees of
+// its opponent's. p1 and p2 are each player's flip probability (its own moves
+// under execution noise, its view of the opponent under perception noise).
+enum class NoiseModel { Execution, Perception };
+
+struct Noise {
+    double p1 = 0.0, p2 = 0.0;
+    NoiseModel model = NoiseModel::Execution;
+
+    bool None() const { return p1 == 0.0 && p2 == 0.0; }
+};
+
+// Streaming mean and variance (Welford); Merge combines two accumulators (Chan et al.).
+struct RunningStats {
+    uint64_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    void Push(double x) {
+        ++count;
+        double delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    void Merge(const RunningStats& other) {
+        if (other.count == 0) return;
+        if (count == 0) { *this = other; return; }
+        uint64_t n = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / n;
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / n);
+        count = n;
+    }
+
+    // Population variance, matching StrategyResult::compute.
+    double Variance() const { return count ? std::max(0.0, m2 / count) : 0.0; }
+    // Unbiased sample variance, for standard errors.
+    double SampleVariance() const { return count > 1 ? std::max(0.0, m2 / (count - 1)) : 0.0; }
+};
+
 struct StrategyResult {
     std::string name;
+    size_t strategy = 0;  // position in the strategy list given to ResultSink::Begin
     double mean_score = 0.0;
     double stdev = 0.0;
     double ci_lower = 0.0;
@@ -64,6 +123,53 @@ struct StrategyResult {
         res.ci_upper = res.mean_score + 1.96 * se;
         return res;
     }
+    static StrategyResult compute(const std::string& name, const RunningStats& stats) {
+        StrategyResult res;
+        res.name = name;
+        if (stats.count == 0) return res;
+
+        res.mean_score = stats.mean;
+        res.stdev = std::sqrt(stats.Variance());
+
+        double se = res.stdev / std::sqrt(static_cast<double>(stats.count));
+        res.ci_lower = res.mean_score - 1.96 * se;
+        res.ci_upper = res.mean_score + 1.96 * se;
+        return res;
+    }
 };
 
-extern std::mt19937 rng;
\ No newline at end of file
+// Probability that a single mutant of strategy `mutant` takes over a population
+// of `resident` (see Engine::RunFixation): the fraction of trials that fixed, its
+// 95% Wilson interval, and the closed-form value of the same Moran process.
+struct FixationResult {
+    size_t resident = 0, mutant = 0;
+    uint64_t trials = 0, fixations = 0;
+    double probability = 0.0;
+    double ci_lower = 0.0;
+    double ci_upper = 0.0;
+    double exact = 0.0;
+};
+
+// Each thread owns its own generator so matches can run concurrently.
+extern thread_local Rng rng;
+
+// splitmix64 finalizer.
+inline uint64_t Mix64(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// Mixes (seed, rep, i, j) into an independent per-match stream seed. The seed is
+// mixed on its own before each value is folded in with a full mix, so nearby
+// seeds do not share streams ((seed + 1, rep) and (seed, rep + 1) differ).
+inline uint64_t MatchSeed(uint64_t seed, uint64_t rep, uint64_t i, uint64_t j) {
+    uint64_t h = Mix64(seed ^ 0x9E3779B97F4A7C15ULL);
+    for (uint64_t v : { rep, i, j }) h = Mix64(h ^ v);
+    return h;
+}
+
+// Reseeds the calling thread's generator for one match.
+inline void Seed_Match_Stream(uint64_t stream) {
+    rng.Seed(stream);
+}
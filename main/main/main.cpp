@@ -1,4 +1,7 @@
 #include "Engine.h"
+#include "Output.h"
+#include "Instrument.h"
+#include "Service.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -18,17 +21,27 @@ vector<string> Split(const string& s, char delimiter) {
     return tokens;
 }
 
-Config Parse_CLI(int argc, char* argv[]) {
+Config Parse_CLI(const vector<string>& args) {
+    const int argc = static_cast<int>(args.size());
     Config cfg;
     cfg.strategies = { "ALLC", "ALLD", "TFT", "GRIM", "PAVLOV" };
-    for (int i = 1; i < argc; ++i) {
-        string arg = argv[i];
-        if (arg == "--rounds" && i + 1 < argc) cfg.rounds = stoi(argv[++i]);
-        else if (arg == "--repeats" && i + 1 < argc) cfg.repeats = stoi(argv[++i]);
-        else if (arg == "--epsilon" && i + 1 < argc) cfg.epsilon = stod(argv[++i]);
-        else if (arg == "--seed" && i + 1 < argc) cfg.seed = stoul(argv[++i]);
+    for (int i = 0; i < argc; ++i) {
+        string arg = args[i];
+        if (arg == "--rounds" && i + 1 < argc) cfg.rounds = stoi(args[++i]);
+        else if (arg == "--repeats" && i + 1 < argc) cfg.repeats = stoi(args[++i]);
+        else if (arg == "--epsilon" && i + 1 < argc) cfg.epsilon = stod(args[++i]);
+        else if (arg == "--noise" && i + 1 < argc) cfg.noise = args[++i];
+        else if (arg == "--player-epsilon" && i + 1 < argc) {
+            for (const auto& item : Split(args[++i], ',')) {
+                auto kv = Split(item, '=');
+                if (kv.size() != 2 || kv[0].empty()) throw runtime_error("--player-epsilon items must be NAME=EPSILON: " + item);
+                cfg.player_epsilon[kv[0]] = stod(kv[1]);
+            }
+        }
+        else if (arg == "--seed" && i + 1 < argc) cfg.seed = stoul(args[++i]);
+        else if (arg == "--threads" && i + 1 < argc) cfg.threads = stoul(args[++i]);
         else if (arg == "--payoffs" && i + 1 < argc) {
-            auto p = Split(argv[++i], ',');
+            auto p = Split(args[++i], ',');
             if (p.size() == 4) {
                 cfg.payoffs.T_temptation = stod(p[0]);
                 cfg.payoffs.R_reward = stod(p[1]);
@@ -36,68 +49,103 @@ Config Parse_CLI(int argc, char* argv[]) {
                 cfg.payoffs.S_sucker = stod(p[3]);
             }
         }
-        else if (arg == "--strategies" && i + 1 < argc) cfg.strategies = Split(argv[++i], ',');
-        else if (arg == "--format" && i + 1 < argc) cfg.format = argv[++i];
+        else if (arg == "--strategies" && i + 1 < argc) cfg.strategies = Split(args[++i], ',');
+        else if (arg == "--format" && i + 1 < argc) cfg.format = args[++i];
+        else if (arg == "--output" && i + 1 < argc) cfg.output = args[++i];
         else if (arg == "--evolve") cfg.evolve = true;
-        else if (arg == "--population" && i + 1 < argc) cfg.population = stoi(argv[++i]);
-        else if (arg == "--generations" && i + 1 < argc) cfg.generations = stoi(argv[++i]);
-        else if (arg == "--mutation" && i + 1 < argc) cfg.mutation = stod(argv[++i]);
+        else if (arg == "--population" && i + 1 < argc) cfg.population = stoi(args[++i]);
+        else if (arg == "--generations" && i + 1 < argc) cfg.generations = stoi(args[++i]);
+        else if (arg == "--mutation" && i + 1 < argc) cfg.mutation = stod(args[++i]);
+        else if (arg == "--selection" && i + 1 < argc) cfg.selection = args[++i];
+        else if (arg == "--lattice" && i + 1 < argc) cfg.lattice = args[++i];
+        else if (arg == "--graph" && i + 1 < argc) cfg.graph = args[++i];
+        else if (arg == "--moore") cfg.moore = true;
+        else if (arg == "--update" && i + 1 < argc) cfg.update = args[++i];
+        else if (arg == "--temperature" && i + 1 < argc) cfg.temperature = stod(args[++i]);
+        else if (arg == "--sweep" && i + 1 < argc) cfg.sweep = args[++i];
+        else if (arg == "--trace") cfg.trace = true;
+        else if (arg == "--counts-cache" && i + 1 < argc) cfg.counts_cache = args[++i];
+        else if (arg == "--target-ci" && i + 1 < argc) cfg.target_ci = stod(args[++i]);
+        else if (arg == "--max-repeats" && i + 1 < argc) cfg.max_repeats = stoi(args[++i]);
+        else if (arg == "--checkpoint" && i + 1 < argc) cfg.checkpoint = args[++i];
+        else if (arg == "--checkpoint-every" && i + 1 < argc) cfg.checkpoint_every = stoi(args[++i]);
+        else if (arg == "--resume") cfg.resume = true;
+        else if (arg == "--plugin" && i + 1 < argc) cfg.plugins.push_back(args[++i]);
+        else if (arg == "--stats" && i + 1 < argc) cfg.stats = args[++i];
+        else if (arg == "--fixation") cfg.fixation = true;
+        else if (arg == "--selection-strength" && i + 1 < argc) cfg.selection_strength = stod(args[++i]);
+        else if (arg == "--fixation-ci" && i + 1 < argc) cfg.fixation_ci = stod(args[++i]);
+        else if (arg == "--fixation-trials" && i + 1 < argc) cfg.fixation_trials = stoull(args[++i]);
+        else if (arg == "--serve" && i + 1 < argc) cfg.serve = args[++i];
+        else if (arg == "--cache-entries" && i + 1 < argc) cfg.cache_entries = stoul(args[++i]);
+        else if (arg == "--shard" && i + 1 < argc) cfg.shard = args[++i];
+        else if (arg == "--merge") {
+            while (i + 1 < argc && args[i + 1].rfind("--", 0) != 0) cfg.merge.push_back(args[++i]);
+        }
+        else if (arg == "--space" && i + 1 < argc) cfg.space = args[++i];
+        else if (arg == "--top-k" && i + 1 < argc) cfg.top_k = stoi(args[++i]);
+        else if (arg == "--payoff-matrix" && i + 1 < argc) cfg.payoff_matrix = args[++i];
         else if (arg == "--scb") cfg.apply_scb = true;
+        else if (arg == "--fast-path") cfg.fast_path = true;
+        else if (arg == "--fsm-batch") cfg.fsm_batch = true;
+        else if (arg == "--exact") cfg.exact = true;
     }
     return cfg;
 }
 
-void Print_Leaderboard(const vector<StrategyResult>& results) {
-    auto sorted_results = results;
-    sort(sorted_results.begin(), sorted_results.end(), [](const auto& a, const auto& b) {
-        return a.mean_score > b.mean_score;
-        });
-
-    cout << left << setw(20) << "Strategy"
-        << setw(15) << "Mean Score"
-        << setw(15) << "Std Dev"
-        << "95% CI" << endl;
-    cout << string(70, '-') << endl;
-
-    for (const auto& res : sorted_results) {
-        cout << left << setw(20) << res.name
-            << fixed << setprecision(3) << setw(15) << res.mean_score
-            << setw(15) << res.stdev
-            << "[" << res.ci_lower << ", " << res.ci_upper << "]" << endl;
+// One CLI invocation; pool and cache are shared with other jobs under --serve.
+int RunJob(const vector<string>& args, ThreadPool* pool, MatchCache* cache) {
+    Config cfg = Parse_CLI(args);
+    auto sink = CreateResultSink(cfg.format, cfg.output);
+    if (!cfg.merge.empty()) {
+        auto results = MergeShards(cfg.merge);
+        vector<string> names;
+        for (const auto& res : results) names.push_back(res.name);
+        sink->Begin(names);
+        sink->OnLeaderboard(results);
+        sink->End();
+        return 0;
     }
-}
+    Engine engine(cfg, pool, cache);
 
-void Print_Evolution(const vector<vector<StrategyResult>>& history) {
-    cout << "--- Evolutionary Dynamics ---" << endl;
-    for (size_t gen = 0; gen < history.size(); ++gen) {
-        cout << "Generation " << gen + 1 << ": ";
-        for (const auto& res : history[gen]) {
-            if (res.population > 0) {
-                cout << res.name << "(" << res.population << ") ";
-            }
-        }
-        cout << endl;
+    if (!cfg.space.empty()) {
+        engine.RunSpaceTournament(sink.get());
+    }
+    else if (cfg.fixation) {
+        engine.RunFixation(sink.get());
+    }
+    else if (!cfg.sweep.empty()) {
+        engine.RunSweep(ParseSweepGrid(cfg.sweep, cfg), sink.get());
     }
+    else if (cfg.evolve && (!cfg.lattice.empty() || !cfg.graph.empty())) {
+        engine.RunSpatialEvolution(sink.get());
+    }
+    else if (cfg.evolve) {
+        engine.RunEvolution(sink.get());
+    }
+    else {
+        engine.RunTournament(sink.get());
+    }
+    if (!cfg.stats.empty()) WriteStatsReport(cerr, engine.Names(), cfg.stats == "json");
+    return 0;
 }
 
-
 int main(int argc, char* argv[]) {
     try {
-        Config cfg = Parse_CLI(argc, argv);
-        Engine engine(cfg);
-
-        if (cfg.evolve) {
-            auto history = engine.RunEvolution();
-            Print_Evolution(history);
-        }
-        else {
-            auto results = engine.RunTournament();
-            Print_Leaderboard(results);
+        vector<string> args(argv + 1, argv + argc);
+        if (args.size() >= 2 && args[0] == "--client") return RunClient(args[1], vector<string>(args.begin() + 2, args.end()));
+        Config cfg = Parse_CLI(args);
+        if (!cfg.serve.empty()) {
+            RunService(cfg.serve, cfg.threads, cfg.cache_entries, [](const vector<string>& job, ThreadPool& pool, MatchCache& cache) {
+                if (!Parse_CLI(job).serve.empty()) throw runtime_error("--serve cannot be sent as a job");
+                return RunJob(job, &pool, &cache);
+            });
+            return 0;
         }
+        return RunJob(args, nullptr, nullptr);
     }
     catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
         return 1;
     }
-    return 0;
-}
\ No newline at end of file
+}
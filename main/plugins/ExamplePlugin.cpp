@@ -0,0 +1,62 @@
+// Example strategy plugin: generous tit-for-tat and tit-for-two-tats behind the
+// C ABI of IpdPlugin.h. Build it (the ipd_example_plugin target) and run
+//   main --plugin ./libipd_example_plugin.so --strategies GTFT,TF2T,TFT,ALLD
+#include "IpdPlugin.h"
+
+namespace {
+
+bool Defected(const uint64_t* history, uint64_t round) { return (history[round >> 6] >> (round & 63)) & 1; }
+
+// Generous TFT: tit-for-tat that forgives a defection with probability 1/3,
+// drawing from its own splitmix64 stream seeded by reset.
+struct Gtft {
+    uint64_t state = 0;
+
+    uint64_t Next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    int Decide(const uint64_t* opp, uint64_t rounds) {
+        if (rounds == 0 || !Defected(opp, rounds - 1)) return 0;
+        return Next() % 3 != 0;
+    }
+};
+
+void* GtftCreate() { return new Gtft(); }
+void GtftDestroy(void* state) { delete static_cast<Gtft*>(state); }
+void GtftReset(void* state, uint64_t seed) { static_cast<Gtft*>(state)->state = seed; }
+int GtftDecide(void* state, const uint64_t*, const uint64_t* opp, uint64_t rounds) {
+    return static_cast<Gtft*>(state)->Decide(opp, rounds);
+}
+void GtftDecideBatch(void* const* states, const uint64_t* const*, const uint64_t* const* opp,
+    uint64_t rounds, size_t lanes, uint8_t* moves) {
+    for (size_t k = 0; k < lanes; ++k) moves[k] = static_cast<uint8_t>(static_cast<Gtft*>(states[k])->Decide(opp[k], rounds));
+}
+
+// Tit-for-two-tats: defects only after two defections in a row. Stateless.
+int Tf2tDecide(const uint64_t* opp, uint64_t rounds) {
+    return rounds >= 2 && Defected(opp, rounds - 1) && Defected(opp, rounds - 2);
+}
+
+void* Tf2tCreate() { return nullptr; }
+void Tf2tDestroy(void*) {}
+void Tf2tReset(void*, uint64_t) {}
+int Tf2tDecideOne(void*, const uint64_t*, const uint64_t* opp, uint64_t rounds) { return Tf2tDecide(opp, rounds); }
+void Tf2tDecideBatch(void* const*, const uint64_t* const*, const uint64_t* const* opp,
+    uint64_t rounds, size_t lanes, uint8_t* moves) {
+    for (size_t k = 0; k < lanes; ++k) moves[k] = static_cast<uint8_t>(Tf2tDecide(opp[k], rounds));
+}
+
+const IpdStrategyApi kStrategies[] = {
+    { IPD_PLUGIN_ABI_VERSION, "GTFT", 0, GtftCreate, GtftDestroy, GtftReset, GtftDecide, GtftDecideBatch },
+    { IPD_PLUGIN_ABI_VERSION, "TF2T", 1, Tf2tCreate, Tf2tDestroy, Tf2tReset, Tf2tDecideOne, Tf2tDecideBatch },
+};
+
+}
+
+extern "C" IPD_PLUGIN_EXPORT const IpdStrategyApi* ipd_plugin_strategies(uint32_t* count) {
+    *count = sizeof(kStrategies) / sizeof(kStrategies[0]);
+    return kStrategies;
+}
@@ -0,0 +1,373 @@
+// Fixed-seed checks of the promises the engine makes: results that do not depend
+// on the thread count, the kernel or sharding, and table kernels that agree with
+// playing the strategies. ctest runs each case as `ipd_tests <case> [args]`.
+#include "Checkpoint.h"
+#include "Engine.h"
+#include "Output.h"
+#include "Plugin.h"
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+using namespace std;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const string& what) {
+    if (!ok) {
+        cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+const vector<string> kBuiltins = { "ALLC", "ALLD", "TFT", "GRIM", "PAVLOV", "RND", "CONTRITE", "PROBER", "SUS_TFT", "ALTERNATE" };
+
+// Everything a run streams, in the order it arrives.
+class RecordingSink : public ResultSink {
+public:
+    vector<tuple<int, size_t, size_t, double, double>> matches;
+    vector<vector<StrategyResult>> generations;
+    vector<StrategyResult> leaderboard;
+
+    void OnMatch(int rep, size_t i, size_t j, double score_i, double score_j) override {
+        matches.emplace_back(rep, i, j, score_i, score_j);
+    }
+    void OnGeneration(int, const vector<StrategyResult>& results) override { generations.push_back(results); }
+    void OnLeaderboard(const vector<StrategyResult>& results) override { leaderboard = results; }
+};
+
+bool Same(const StrategyResult& a, const StrategyResult& b) {
+    return a.name == b.name && a.strategy == b.strategy && a.mean_score == b.mean_score && a.stdev == b.stdev
+        && a.ci_lower == b.ci_lower && a.ci_upper == b.ci_upper && a.population == b.population;
+}
+
+bool Same(const vector<StrategyResult>& a, const vector<StrategyResult>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (!Same(a[k], b[k])) return false;
+    }
+    return true;
+}
+
+bool Same(const vector<vector<StrategyResult>>& a, const vector<vector<StrategyResult>>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (!Same(a[k], b[k])) return false;
+    }
+    return true;
+}
+
+Config NoisyTournament() {
+    Config cfg;
+    cfg.strategies = kBuiltins;
+    cfg.rounds = 70;
+    cfg.repeats = 12;
+    cfg.epsilon = 0.03;
+    cfg.seed = 11;
+    return cfg;
+}
+
+// The matches of a tournament replayed one by one through CountMatch, in the
+// (rep, i, j) order and with the stream seeds Engine uses.
+RecordingSink PerMatch(const Config& cfg) {
+    RecordingSink out;
+    const size_t n = cfg.strategies.size();
+    for (int rep = 0; rep < cfg.repeats; ++rep) {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = i; j < n; ++j) {
+                auto p1 = CreateStrategy(cfg.strategies[i]);
+                auto p2 = CreateStrategy(cfg.strategies[j]);
+                Seed_Match_Stream(MatchSeed(cfg.seed, rep, i, j));
+                auto scores = CountMatch(*p1, *p2, cfg.rounds, cfg.epsilon).Score(cfg.payoffs);
+                out.matches.emplace_back(rep, i, j, scores.first, scores.second);
+            }
+        }
+    }
+    return out;
+}
+
+RecordingSink Tournament(const Config& cfg) {
+    RecordingSink sink;
+    Engine(cfg).RunTournament(&sink);
+    return sink;
+}
+
+// Every kind of run gives the same results on 1 thread and on several.
+void TestThreads() {
+    for (unsigned int threads : { 2u, 4u, 7u }) {
+        string label = " with " + to_string(threads) + " threads";
+        Config one = NoisyTournament(), many = one;
+        many.threads = threads;
+        auto a = Tournament(one), b = Tournament(many);
+        Check(a.matches == b.matches && Same(a.leaderboard, b.leaderboard), "tournament" + label);
+
+        for (const char* selection : { "proportional", "wright-fisher", "moran" }) {
+            Config evolve = NoisyTournament();
+            evolve.evolve = true;
+            evolve.generations = 15;
+            evolve.population = 60;
+            evolve.selection = selection;
+            Config evolve_many = evolve;
+            evolve_many.threads = threads;
+            Check(Same(Engine(evolve).RunEvolution(), Engine(evolve_many).RunEvolution()), string("evolution, ") + selection + label);
+        }
+
+        Config spatial = NoisyTournament();
+        spatial.evolve = true;
+        spatial.generations = 6;
+        spatial.lattice = "12x9";
+        spatial.update = "fermi";
+        Config spatial_many = spatial;
+        spatial_many.threads = threads;
+        Check(Same(Engine(spatial).RunSpatialEvolution(), Engine(spatial_many).RunSpatialEvolution()), "spatial evolution" + label);
+
+        Config sweep = NoisyTournament();
+        auto points = ParseSweepGrid("rounds=30,70;epsilon=0,0.03;payoffs=5/3/1/0,4/3/1/0", sweep);
+        Config sweep_many = sweep;
+        sweep_many.threads = threads;
+        Check(Same(Engine(sweep).RunSweep(points), Engine(sweep_many).RunSweep(points)), "sweep" + label);
+    }
+}
+
+// The virtual and statically dispatched paths play exactly the matches of
+// CountMatch, noisy or not.
+void TestFastPath() {
+    for (double epsilon : { 0.0, 0.03 }) {
+        Config cfg = NoisyTournament();
+        cfg.epsilon = epsilon;
+        string label = " at epsilon " + to_string(epsilon);
+        auto reference = PerMatch(cfg);
+        auto virtual_path = Tournament(cfg);
+        cfg.fast_path = true;
+        auto fast = Tournament(cfg);
+        Check(virtual_path.matches == reference.matches, "virtual path against CountMatch" + label);
+        Check(fast.matches == reference.matches, "fast path against CountMatch" + label);
+        Check(Same(fast.leaderboard, virtual_path.leaderboard), "fast path leaderboard" + label);
+    }
+}
+
+// Table forms against the strategies they stand for, for every built-in pair
+// that has them.
+void TestFsmKernels() {
+    const int rounds = 150;
+    const size_t lanes = 37; // not a multiple of any SIMD width, so the scalar tail runs too
+    vector<uint64_t> seeds(lanes);
+    for (size_t k = 0; k < lanes; ++k) seeds[k] = MatchSeed(3, k, 1, 2);
+
+    for (const auto& a_name : kBuiltins) {
+        for (const auto& b_name : kBuiltins) {
+            auto a = BuiltinFsm(a_name), b = BuiltinFsm(b_name);
+            if (!a || !b) continue;
+            string pair = a_name + "-" + b_name;
+            auto p1 = CreateStrategy(a_name), p2 = CreateStrategy(b_name);
+            FsmPlayer f1(*a), f2(*b);
+
+            // Noise-free, every kernel gives the single possible outcome.
+            Seed_Match_Stream(1);
+            OutcomeCounts played = CountMatch(*p1, *p2, rounds, 0.0);
+            vector<OutcomeCounts> batch(lanes);
+            CountFsmBatch(*a, *b, rounds, 0.0, seeds.data(), lanes, batch.data());
+            OutcomeCounts exact = ExactFsmCounts(*a, *b, rounds, 0.0);
+            auto same = [](const OutcomeCounts& x, const OutcomeCounts& y) {
+                return x.cc == y.cc && x.cd == y.cd && x.dc == y.dc && x.dd == y.dd;
+            };
+            bool batch_ok = true;
+            for (const auto& c : batch) batch_ok = batch_ok && same(c, played);
+            Check(batch_ok, "CountFsmBatch against CountMatch, " + pair);
+            Check(same(exact, played), "ExactFsmCounts against CountMatch, " + pair);
+
+            // Under noise the table plays the same moves as the strategy on the same stream.
+            Seed_Match_Stream(5);
+            OutcomeCounts noisy = CountMatch(*p1, *p2, rounds, 0.05);
+            Seed_Match_Stream(5);
+            Check(same(CountMatch(f1, f2, rounds, 0.05), noisy), "FsmPlayer against the strategy under noise, " + pair);
+
+            // A lane does not depend on how many lanes run with it.
+            vector<OutcomeCounts> noisy_batch(lanes);
+            CountFsmBatch(*a, *b, rounds, 0.05, seeds.data(), lanes, noisy_batch.data());
+            bool lanes_ok = true;
+            for (size_t k = 0; k < lanes; ++k) {
+                OutcomeCounts single;
+                CountFsmBatch(*a, *b, rounds, 0.05, &seeds[k], 1, &single);
+                lanes_ok = lanes_ok && same(single, noisy_batch[k]);
+            }
+            Check(lanes_ok, "CountFsmBatch lanes against single lanes, " + pair);
+
+            // The expectation matches the mean of sampled matches within 5 standard errors.
+            const int samples = 3000;
+            OutcomeCounts expected = ExactFsmCounts(*a, *b, rounds, 0.05);
+            double sum = 0.0, sq = 0.0;
+            for (int s = 0; s < samples; ++s) {
+                Seed_Match_Stream(MatchSeed(9, s, 0, 0));
+                double cc = CountMatch(*p1, *p2, rounds, 0.05).cc;
+                sum += cc;
+                sq += cc * cc;
+            }
+            double mean = sum / samples, se = sqrt(max(0.0, sq / samples - mean * mean) / samples);
+            Check(fabs(mean - expected.cc) <= 5 * se + 1e-9, "ExactFsmCounts against sampled CountMatch under noise, " + pair);
+        }
+    }
+}
+
+// Plugin pairings are played as lanes over the repeats; each lane must be the
+// match CountMatch plays on the same stream.
+void TestPluginLanes(const string& plugin) {
+    LoadPlugin(plugin);
+    for (double epsilon : { 0.0, 0.03 }) {
+        Config cfg = NoisyTournament();
+        cfg.strategies = { "GTFT", "TFT", "RND", "GTFT" };
+        cfg.plugins = { plugin };
+        cfg.epsilon = epsilon;
+        string label = " at epsilon " + to_string(epsilon);
+        Check(Tournament(cfg).matches == PerMatch(cfg).matches, "plugin lanes against CountMatch" + label);
+        Config many = cfg;
+        many.threads = 4;
+        Check(Tournament(many).matches == PerMatch(cfg).matches, "plugin lanes with 4 threads" + label);
+    }
+}
+
+// Merging every shard of a tournament gives the leaderboard of the unsharded
+// run, for each kernel, including shard counts that split the segments unevenly.
+void TestShardMerge() {
+    Config base;
+    base.strategies = { "TFT", "GRIM", "RND", "PAVLOV" };
+    base.rounds = 20;
+    base.repeats = 45000; // 450000 matches: 7 segments, the last one partial
+    base.epsilon = 0.02;
+    base.seed = 5;
+    base.output = "ipd_tests.shard-merge";
+    for (const char* kernel : { "match", "fsm-batch", "exact" }) {
+        Config cfg = base;
+        cfg.fsm_batch = string(kernel) == "fsm-batch";
+        cfg.exact = string(kernel) == "exact";
+        auto single = Engine(cfg).RunTournament();
+        for (uint32_t shards : { 3u, 9u }) {
+            vector<string> paths;
+            for (uint32_t k = 0; k < shards; ++k) {
+                Config part = cfg;
+                part.shard = to_string(k) + "/" + to_string(shards);
+                part.threads = 2;
+                Engine(part).RunTournament();
+                paths.push_back(ShardPath(cfg.output, ParseShard(part.shard)));
+            }
+            Check(Same(MergeShards(paths), single), string(kernel) + " merged from " + to_string(shards) + " shards");
+            for (const auto& path : paths) remove(path.c_str());
+        }
+    }
+}
+
+// An evolution stopped after a checkpoint and resumed streams the generations of
+// an uninterrupted run; a checkpoint of other settings is refused.
+void TestCheckpointResume() {
+    const string path = "ipd_tests.checkpoint";
+    auto clear = [&] {
+        remove(path.c_str());
+        remove((path + ".history").c_str());
+    };
+    for (const char* selection : { "proportional", "wright-fisher", "moran" }) {
+        Config cfg = NoisyTournament();
+        cfg.evolve = true;
+        cfg.generations = 40;
+        cfg.population = 60;
+        cfg.selection = selection;
+        RecordingSink full;
+        Engine(cfg).RunEvolution(&full);
+
+        clear();
+        Config first = cfg;
+        first.checkpoint = path;
+        first.checkpoint_every = 7;
+        first.generations = 17; // the key leaves out generations, so this stands in for a run stopped at 17
+        Engine(first).RunEvolution();
+        EvolutionState state;
+        vector<HistoryRecord> history;
+        Check(LoadCheckpoint(path, EvolutionCheckpointKey(cfg), state, history) && state.generation == first.generations
+            && !history.empty() && history.back().generation == first.generations - 1, string("checkpoint at the stop, ") + selection);
+        Config resumed = first;
+        resumed.generations = cfg.generations;
+        resumed.resume = true;
+        resumed.threads = 3;
+        RecordingSink rest;
+        Engine(resumed).RunEvolution(&rest);
+        Check(Same(rest.generations, full.generations), string("resumed evolution, ") + selection);
+
+        Config other = resumed;
+        other.seed = cfg.seed + 1;
+        bool refused = false;
+        try {
+            Engine(other).RunEvolution();
+        }
+        catch (const runtime_error&) {
+            refused = true;
+        }
+        Check(refused, string("resume from a checkpoint of another seed, ") + selection);
+    }
+    clear();
+}
+
+// Tit for tat written against the Strategy API from before clone and clone_into.
+class LegacyTft : public Strategy {
+private:
+    string label;
+
+public:
+    explicit LegacyTft(string name) : label(move(name)) {}
+    Move decide(const History&, const History& opp_history) override {
+        return opp_history.empty() ? Move::C : opp_history.back();
+    }
+    string name() const override { return label; }
+};
+
+// A registered strategy without the prototype API is cloned through the registry
+// and plays like its CloneableStrategy counterpart; an unregistered one is refused.
+void TestRegistryClone() {
+    RegisterStrategy("LEGACY_TFT", [] { return make_unique<LegacyTft>("LEGACY_TFT"); });
+    Config legacy = NoisyTournament();
+    legacy.strategies = { "TFT", "LEGACY_TFT", "RND" };
+    legacy.threads = 3;
+    Config builtin = legacy;
+    builtin.strategies = { "TFT", "TFT", "RND" };
+    Check(Tournament(legacy).matches == Tournament(builtin).matches, "registry clones against TFT");
+
+    bool refused = false;
+    try {
+        LegacyTft("UNREGISTERED_TFT").clone();
+    }
+    catch (const runtime_error&) {
+        refused = true;
+    }
+    Check(refused, "clone of an unregistered strategy");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const map<string, function<void(const vector<string>&)>> tests = {
+        { "threads", [](const vector<string>&) { TestThreads(); } },
+        { "fast-path", [](const vector<string>&) { TestFastPath(); } },
+        { "fsm-kernels", [](const vector<string>&) { TestFsmKernels(); } },
+        { "plugin-lanes", [](const vector<string>& args) { TestPluginLanes(args.at(0)); } },
+        { "shard-merge", [](const vector<string>&) { TestShardMerge(); } },
+        { "checkpoint-resume", [](const vector<string>&) { TestCheckpointResume(); } },
+        { "registry-clone", [](const vector<string>&) { TestRegistryClone(); } },
+    };
+    if (argc < 2 || !tests.count(argv[1])) {
+        cerr << "Usage: ipd_tests <case> [args]; cases:";
+        for (const auto& kv : tests) cerr << ' ' << kv.first;
+        cerr << '\n';
+        return 2;
+    }
+    try {
+        tests.at(argv[1])(vector<string>(argv + 2, argv + argc));
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    if (failures) cerr << failures << " check(s) failed\n";
+    return failures ? 1 : 0;
+}